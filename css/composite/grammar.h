@@ -45,21 +45,15 @@ struct function_close : token::paren_close
 struct function;
 
 struct term :
-  rule::sor<
+  token::dispatch_sor<
     composite::function,
     rule::seq<
-      rule::sor<
-        token::percentage,
-        token::length,
-        token::ems,
-        token::exs,
-        token::angle,
-        token::time,
-        token::frequency,
+      token::dispatch_sor<
+        // Numbers cannot begin a string, identifier or url, so trying
+        // them first does not change what matches.
+        token::numeric,
         token::string,
         token::ident,
-        token::dimension,
-        token::number,
         token::url
       >,
       token::optional_whitespace
@@ -194,7 +188,7 @@ struct attrib :
 };
 
 struct element_name :
-  rule::sor<
+  token::dispatch_sor<
     token::ident,
     token::star
   >
@@ -221,7 +215,7 @@ struct combinator :
 };
 
 struct selector_modifier :
-  rule::sor<
+  token::dispatch_sor<
     token::hash,
     composite::class_modifier,
     composite::attrib,
@@ -231,7 +225,7 @@ struct selector_modifier :
 };
 
 struct simple_selector :
-  rule::sor<
+  token::dispatch_sor<
     rule::seq<
       composite::element_name,
       rule::star<composite::selector_modifier>
@@ -241,22 +235,25 @@ struct simple_selector :
 {
 };
 
+/// A complex selector: compound (simple) selectors joined by combinators.
+///
+/// Compounds are matched in a loop rather than by recursing after each
+/// combinator, so the stack depth does not grow with the number of
+/// compounds (generated selectors may have hundreds).
 struct selector :
   rule::seq<
     composite::simple_selector,
-    rule::opt<
+    rule::star<
       rule::sor<
         rule::seq<
           composite::combinator,
-          composite::selector
+          composite::simple_selector
         >,
         rule::seq<
           token::whitespace,
           rule::opt<
-            rule::seq<
-              rule::opt<composite::combinator>,
-              composite::selector
-            >
+            rule::opt<composite::combinator>,
+            composite::simple_selector
           >
         >
       >
@@ -556,7 +553,7 @@ struct import_rule :
   rule::seq<
     token::import_keyword,
     token::optional_whitespace,
-    rule::sor<token::string, token::url>,
+    token::dispatch_sor<token::string, token::url>,
     token::optional_whitespace,
     rule::opt<composite::media_list>,
     token::semicolon,
@@ -600,7 +597,7 @@ struct stylesheet :
     >,
     composite::import_rules,
     rule::star<
-      rule::sor<
+      token::dispatch_sor<
         composite::ruleset,
         composite::media,
         composite::page
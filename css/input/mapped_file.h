@@ -0,0 +1,168 @@
+#ifndef css_input_mapped_file_h
+#define css_input_mapped_file_h
+#include "css/config.h"
+
+#if CSS_HAVE_MMAP
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+namespace css
+{
+
+/// Sources of stylesheet text that can be handed to the parser.
+namespace input
+{
+
+/// The read-only contents of a stylesheet file.
+///
+/// Regular files are memory-mapped and the kernel is advised that
+/// they will be read sequentially, so the parser reads straight from
+/// the page cache without copying the file. Pipes, character devices,
+/// standard input (named "-"), and platforms without `mmap()` fall
+/// back to a single read into an owned buffer.
+///
+/// The parser input returned by input() refers to this object's
+/// storage, so the mapped_file must outlive it (and anything that
+/// keeps pointers into it).
+class mapped_file
+{
+public:
+  /// Map (or read) \a filename; throws std::system_error on failure.
+  explicit mapped_file(const std::string& filename)
+    : m_source(filename)
+  {
+    if (filename == "-")
+    {
+      this->read_stream(std::cin);
+      return;
+    }
+#if CSS_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      throw std::system_error(errno, std::generic_category(), "Unable to open \"" + filename + "\"");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+      m_size = static_cast<std::size_t>(info.st_size);
+      if (m_size == 0)
+      {
+        ::close(fd);
+        m_data = m_buffer.data();
+        return;
+      }
+      void* mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED)
+      {
+        ::close(fd);
+#  ifdef MADV_SEQUENTIAL
+        ::madvise(mapping, m_size, MADV_SEQUENTIAL);
+#  endif
+#  ifdef MADV_WILLNEED
+        ::madvise(mapping, m_size, MADV_WILLNEED);
+#  endif
+        m_mapping = mapping;
+        m_data = static_cast<const char*>(mapping);
+        return;
+      }
+      m_size = 0;
+    }
+    // Not a regular file (or it could not be mapped): read what the descriptor provides.
+    this->read_descriptor(fd, filename);
+    ::close(fd);
+#else
+    std::ifstream stream(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!stream)
+    {
+      throw std::system_error(errno, std::generic_category(), "Unable to open \"" + filename + "\"");
+    }
+    this->read_stream(stream);
+#endif
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator = (const mapped_file&) = delete;
+
+  ~mapped_file()
+  {
+#if CSS_HAVE_MMAP
+    if (m_mapping)
+    {
+      ::munmap(m_mapping, m_size);
+    }
+#endif
+  }
+
+  /// The first byte of the file's contents.
+  const char* data() const { return m_data; }
+  /// The number of bytes in the file.
+  std::size_t size() const { return m_size; }
+  /// The name used to report parse errors.
+  const std::string& source() const { return m_source; }
+  /// Returns true when the contents are memory-mapped rather than copied.
+  bool mapped() const { return m_mapping != nullptr; }
+
+  /// Return a parser input that reads directly from this file's contents.
+  rule::memory_input<> input() const
+  {
+    return rule::memory_input<>(m_data, m_size, m_source);
+  }
+
+protected:
+  void read_stream(std::istream& stream)
+  {
+    m_buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+  }
+
+#if CSS_HAVE_MMAP
+  void read_descriptor(int fd, const std::string& filename)
+  {
+    char chunk[65536];
+    for (;;)
+    {
+      ssize_t count = ::read(fd, chunk, sizeof(chunk));
+      if (count < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Unable to read \"" + filename + "\"");
+      }
+      if (count == 0)
+      {
+        break;
+      }
+      m_buffer.append(chunk, static_cast<std::size_t>(count));
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+  }
+#endif
+
+  std::string m_source;
+  std::string m_buffer;
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+  void* m_mapping = nullptr;
+};
+
+} // namespace input
+} // namespace css
+
+#endif // css_input_mapped_file_h
@@ -0,0 +1,131 @@
+#ifndef css_match_bloom_h
+#define css_match_bloom_h
+#include "css/match/selector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace css
+{
+namespace match
+{
+
+/// A counting Bloom filter of the types, IDs and classes of an element's ancestors.
+///
+/// Keep one of these while walking a document depth first: push() an
+/// element before visiting its children and pop() it afterwards, so
+/// the filter always holds exactly the ancestors of the elements being
+/// matched. A selector whose ancestor_hashes() are not all present
+/// cannot match (see might_match()), so most descendant selectors are
+/// rejected without walking up the tree. False positives only cost the
+/// walk that would have happened anyway.
+///
+/// Each name sets two of 4096 8-bit counters. A counter that saturates
+/// stays set, which keeps the filter correct (if less selective) for
+/// documents of any depth.
+class ancestor_filter
+{
+public:
+  static constexpr unsigned key_bits = 12;
+  static constexpr std::size_t counter_count = std::size_t(1) << key_bits;
+
+  ancestor_filter()
+  {
+    this->clear();
+  }
+
+  /// Forget every ancestor.
+  void clear()
+  {
+    std::memset(m_counters, 0, sizeof(m_counters));
+    m_depth = 0;
+  }
+
+  /// Fill the filter with the ancestors of \a target (for matching out of document order).
+  void assign(const element& target)
+  {
+    this->clear();
+    for (const element* ancestor = target.parent; ancestor; ancestor = ancestor->parent)
+    {
+      this->push(*ancestor);
+    }
+  }
+
+  /// Add \a ancestor before matching its descendants.
+  void push(const element& ancestor)
+  {
+    this->update(ancestor, +1);
+    ++m_depth;
+  }
+
+  /// Remove \a ancestor (which must be the last one pushed and not popped).
+  void pop(const element& ancestor)
+  {
+    this->update(ancestor, -1);
+    --m_depth;
+  }
+
+  /// The number of ancestors in the filter.
+  std::size_t depth() const { return m_depth; }
+
+  /// Returns true when some ancestor may have the type, ID or class that was hashed to \a hash.
+  bool might_contain(std::uint32_t hash) const
+  {
+    return m_counters[hash & key_mask] != 0 && m_counters[(hash >> key_bits) & key_mask] != 0;
+  }
+
+  /// Returns false when \a compiled cannot match an element whose ancestors are in the filter.
+  bool might_match(const selector& compiled) const
+  {
+    const std::uint32_t* hashes = compiled.ancestor_hashes();
+    for (std::size_t ii = 0; ii < compiled.ancestor_hash_count(); ++ii)
+    {
+      if (!this->might_contain(hashes[ii]))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+protected:
+  static constexpr std::uint32_t key_mask = counter_count - 1;
+
+  void update(const element& ancestor, int delta)
+  {
+    this->update(selector::ancestor_hash(selector::test_kind::type, ancestor.tag), delta, ancestor.tag);
+    this->update(selector::ancestor_hash(selector::test_kind::id, ancestor.id), delta, ancestor.id);
+    for (parser::atom name : ancestor.classes)
+    {
+      this->update(selector::ancestor_hash(selector::test_kind::class_, name), delta, name);
+    }
+  }
+
+  void update(std::uint32_t hash, int delta, parser::atom name)
+  {
+    if (name == parser::atom::none)
+    {
+      return;
+    }
+    this->update(m_counters[hash & key_mask], delta);
+    this->update(m_counters[(hash >> key_bits) & key_mask], delta);
+  }
+
+  static void update(std::uint8_t& counter, int delta)
+  {
+    // A saturated counter may be shared by more names than it can count, so it never changes again.
+    if (counter != 0xff)
+    {
+      counter = static_cast<std::uint8_t>(counter + delta);
+    }
+  }
+
+  std::uint8_t m_counters[counter_count];
+  std::size_t m_depth = 0;
+};
+
+} // namespace match
+} // namespace css
+
+#endif // css_match_bloom_h
@@ -0,0 +1,163 @@
+#ifndef css_match_cascade_h
+#define css_match_cascade_h
+#include "css/parser/state.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace css
+{
+namespace match
+{
+
+/// Return the precedence (0 to 7, highest wins) of declarations from \a source.
+///
+/// Normal declarations rank user-agent, user, then author; animations
+/// override them; important declarations then rank in reverse (author,
+/// user, user-agent); transitions override everything. Animations and
+/// transitions ignore importance.
+inline std::uint32_t cascade_layer(origin source, bool important)
+{
+  switch (source)
+  {
+  case origin::user_agent:
+    return important ? 6 : 0;
+  case origin::user:
+    return important ? 5 : 1;
+  case origin::author:
+    return important ? 4 : 2;
+  case origin::animation:
+    return 3;
+  case origin::transition:
+    return 7;
+  }
+  return 0;
+}
+
+/// Resolve the declarations that apply to an element.
+///
+/// Add every rule that matched the element (in any order) with
+/// add_rule(), or add declarations with their selector's specificity
+/// and source order, then call resolve(). The winner for each property
+/// is the declaration with the highest cascade_layer(), then
+/// specificity, then stylesheet, then source order, which a single
+/// sort of the candidates finds. Reuse one cascade for many elements
+/// to reuse its storage.
+template<typename Property>
+class cascade
+{
+public:
+  /// Add each of \a declarations (the block of a matched rule) as a candidate.
+  ///
+  /// When cascading several stylesheets, give later ones a higher \a sheet.
+  template<typename Block>
+  void add(const Block& declarations, std::uint32_t specificity, std::uint32_t sheet = 0)
+  {
+    for (const Property& declaration : declarations)
+    {
+      this->add(declaration, specificity, sheet);
+    }
+  }
+
+  /// Add the declarations of \a rule (a basic_rule), at the rule's specificity and source order.
+  template<typename Rule>
+  void add_rule(const Rule& rule, std::uint32_t sheet = 0)
+  {
+    for (const Property& declaration : rule)
+    {
+      this->add(declaration, rule.specificity, sheet, rule.source_order(declaration));
+    }
+  }
+
+  /// Add a single \a declaration as a candidate.
+  void add(const Property& declaration, std::uint32_t specificity, std::uint32_t sheet = 0)
+  {
+    this->add(declaration, specificity, sheet, declaration.order);
+  }
+
+  /// Add a single \a declaration as a candidate, at the given source \a order.
+  void add(const Property& declaration, std::uint32_t specificity, std::uint32_t sheet, std::uint32_t order)
+  {
+    candidate entry;
+    entry.weight =
+      (static_cast<std::uint64_t>(cascade_layer(declaration.source, declaration.important)) << 56) |
+      (static_cast<std::uint64_t>(specificity & 0xffffff) << 32) |
+      sheet;
+    entry.order = order;
+    entry.declaration = &declaration;
+    m_candidates.push_back(entry);
+  }
+
+  /// The number of candidates added since the last clear().
+  std::size_t size() const { return m_candidates.size(); }
+
+  /// Forget every candidate (and the last result).
+  void clear()
+  {
+    m_candidates.clear();
+    m_winners.clear();
+  }
+
+  /// Return the winning declaration of each property, from highest to lowest precedence.
+  ///
+  /// The result refers to the declarations that were added and is
+  /// valid until the next call to clear() or resolve().
+  const std::vector<const Property*>& resolve()
+  {
+    std::sort(m_candidates.begin(), m_candidates.end(),
+      [](const candidate& aa, const candidate& bb)
+      {
+        return aa.weight != bb.weight ? aa.weight > bb.weight : aa.order > bb.order;
+      });
+    m_winners.clear();
+    std::bitset<256> known;
+    m_custom.clear();
+    for (const auto& entry : m_candidates)
+    {
+      const Property& declaration = *entry.declaration;
+      const parser::property_id id = declaration.id != parser::property_id::unknown ?
+        declaration.id : parser::property_from_name(declaration.name);
+      if (id != parser::property_id::unknown)
+      {
+        if (known.test(static_cast<std::size_t>(id)))
+        {
+          continue;
+        }
+        known.set(static_cast<std::size_t>(id));
+      }
+      else
+      {
+        const std::string_view name(declaration.name);
+        if (std::any_of(m_custom.begin(), m_custom.end(),
+            [name](std::string_view seen) { return parser::property_name_equal(seen, name); }))
+        {
+          continue;
+        }
+        m_custom.push_back(name);
+      }
+      m_winners.push_back(&declaration);
+    }
+    return m_winners;
+  }
+
+protected:
+  struct candidate
+  {
+    std::uint64_t weight; //!< The layer, specificity and stylesheet, packed to compare as one integer.
+    std::uint32_t order;
+    const Property* declaration;
+  };
+
+  std::vector<candidate> m_candidates;
+  std::vector<const Property*> m_winners;
+  std::vector<std::string_view> m_custom; //!< The names of unknown properties that have a winner.
+};
+
+} // namespace match
+} // namespace css
+
+#endif // css_match_cascade_h
@@ -0,0 +1,222 @@
+#ifndef css_match_index_h
+#define css_match_index_h
+#include "css/match/bloom.h"
+#include "css/match/cascade.h"
+#include "css/match/selector.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace css
+{
+namespace match
+{
+
+/// Selectors indexed by their rightmost compound (a "rule hash").
+///
+/// Each selector is filed in one bucket, chosen from its subject
+/// (rightmost) compound: its ID if it has one, else its first class,
+/// else its type, else the bucket of universal selectors. An element
+/// then only tests the selectors in the buckets of its ID, its classes,
+/// its tag and the universal bucket, since no other selector can match
+/// it.
+class rule_index
+{
+public:
+  /// Add \a compiled under the caller's \a rule number (e.g., an index into their rules).
+  ///
+  /// Selectors that are not valid() are dropped since they never match.
+  void add(selector compiled, std::uint32_t rule)
+  {
+    if (!compiled.valid())
+    {
+      return;
+    }
+    const auto index = static_cast<std::uint32_t>(m_entries.size());
+    std::vector<std::uint32_t>* bucket = &m_universal;
+    const auto& subject = compiled.compounds().front();
+    const auto& tests = compiled.tests();
+    int rank = 0; // Prefer IDs (3) over classes (2) over types (1).
+    for (std::uint32_t ii = subject.first; ii < subject.first + subject.count; ++ii)
+    {
+      const auto& check = tests[ii];
+      if (check.kind == selector::test_kind::id && rank < 3)
+      {
+        bucket = &m_ids[check.name];
+        rank = 3;
+      }
+      else if (check.kind == selector::test_kind::class_ && rank < 2)
+      {
+        bucket = &m_classes[check.name];
+        rank = 2;
+      }
+      else if (check.kind == selector::test_kind::type && rank < 1)
+      {
+        bucket = &m_tags[check.name];
+        rank = 1;
+      }
+    }
+    bucket->push_back(index);
+    std::size_t run = 0;
+    for (const auto& each : compiled.compounds())
+    {
+      run = each.relation == parser::combinator::adjacent ? run + 1 : 0;
+      m_sibling_depth = run > m_sibling_depth ? run : m_sibling_depth;
+    }
+    m_entries.push_back(entry{ std::move(compiled), rule });
+  }
+
+  /// The number of selectors indexed.
+  std::size_t size() const { return m_entries.size(); }
+
+  /// The most adjacent (`+`) combinators in a row in any selector.
+  ///
+  /// Besides an element and its ancestors, matching only looks at this
+  /// many of its previous siblings.
+  std::size_t sibling_depth() const { return m_sibling_depth; }
+
+  /// Invoke \a visitor with the rule number of each selector that matches \a target.
+  ///
+  /// Rules are visited bucket by bucket, not in rule order. When \a ancestors
+  /// holds the ancestors of \a target, selectors it rules out are skipped
+  /// without being tested. Returns the number of selectors that were tested.
+  template<typename Visitor>
+  std::size_t visit(const element& target, const ancestor_filter* ancestors, Visitor&& visitor) const
+  {
+    std::size_t tested = 0;
+    auto scan = [&](const std::vector<std::uint32_t>& bucket)
+    {
+      for (std::uint32_t index : bucket)
+      {
+        const auto& candidate = m_entries[index];
+        if (ancestors && !ancestors->might_match(candidate.compiled))
+        {
+          continue;
+        }
+        ++tested;
+        if (candidate.compiled.matches(target))
+        {
+          visitor(candidate.rule);
+        }
+      }
+    };
+    auto scan_key = [&](const std::unordered_map<parser::atom, std::vector<std::uint32_t>>& buckets, parser::atom key)
+    {
+      auto it = key == parser::atom::none ? buckets.end() : buckets.find(key);
+      if (it != buckets.end())
+      {
+        scan(it->second);
+      }
+    };
+    scan_key(m_ids, target.id);
+    for (auto it = target.classes.begin(); it != target.classes.end(); ++it)
+    {
+      // An element that lists a class twice must not match its rules twice.
+      if (std::find(target.classes.begin(), it, *it) == it)
+      {
+        scan_key(m_classes, *it);
+      }
+    }
+    scan_key(m_tags, target.tag);
+    scan(m_universal);
+    return tested;
+  }
+
+  template<typename Visitor>
+  std::size_t visit(const element& target, Visitor&& visitor) const
+  {
+    return this->visit(target, nullptr, std::forward<Visitor>(visitor));
+  }
+
+  /// Append the rule numbers of the selectors that match \a target to \a rules, in ascending order.
+  ///
+  /// Returns the number of selectors that were tested.
+  std::size_t collect(const element& target, std::vector<std::uint32_t>& rules,
+    const ancestor_filter* ancestors = nullptr) const
+  {
+    const std::size_t first = rules.size();
+    const std::size_t tested = this->visit(target, ancestors, [&rules](std::uint32_t rule) { rules.push_back(rule); });
+    std::sort(rules.begin() + static_cast<std::ptrdiff_t>(first), rules.end());
+    return tested;
+  }
+
+protected:
+  struct entry
+  {
+    selector compiled;
+    std::uint32_t rule;
+  };
+
+  std::vector<entry> m_entries;
+  std::unordered_map<parser::atom, std::vector<std::uint32_t>> m_ids;
+  std::unordered_map<parser::atom, std::vector<std::uint32_t>> m_classes;
+  std::unordered_map<parser::atom, std::vector<std::uint32_t>> m_tags;
+  std::vector<std::uint32_t> m_universal;
+  std::size_t m_sibling_depth = 0;
+};
+
+/// The rules of a parsed stylesheet, indexed for matching.
+///
+/// Each selector (a key of basic_stylesheet::properties) is compiled
+/// with the stylesheet's atoms, so elements must be described with
+/// atoms from sheet.atoms(). The stylesheet must outlive this object.
+template<typename Sheet>
+class stylesheet_rules
+{
+public:
+  using property_type = typename Sheet::property_type;
+  using property_data_type = typename Sheet::property_data_type;
+  using rule_type = typename Sheet::rule_type;
+
+  explicit stylesheet_rules(const Sheet& sheet)
+  {
+    for (const auto& entry : sheet.properties)
+    {
+      m_index.add(compile(std::string_view(entry.first), sheet.atoms()), static_cast<std::uint32_t>(m_rules.size()));
+      m_rules.push_back(&entry.second);
+    }
+  }
+
+  const rule_index& index() const { return m_index; }
+
+  /// The number of rules (including those whose selectors never match).
+  std::size_t size() const { return m_rules.size(); }
+  /// Rule number \a rule.
+  const rule_type& rule(std::uint32_t rule) const { return *m_rules[rule]; }
+  /// The declarations of rule number \a rule.
+  const property_data_type& declarations(std::uint32_t rule) const { return m_rules[rule]->declarations(); }
+
+  /// Append the declarations of the rules that match \a target to \a matched.
+  ///
+  /// Pass the \a ancestors of \a target to skip most descendant
+  /// selectors that cannot match. Returns the number of selectors that
+  /// were tested.
+  std::size_t match(const element& target, std::vector<const property_data_type*>& matched,
+    const ancestor_filter* ancestors = nullptr) const
+  {
+    return m_index.visit(target, ancestors, [&](std::uint32_t rule) { matched.push_back(&m_rules[rule]->declarations()); });
+  }
+
+  /// Add the declarations of the rules that match \a target to \a candidates.
+  ///
+  /// Pass a higher \a sheet for each stylesheet cascaded after this
+  /// one. Returns the number of selectors that were tested.
+  std::size_t apply(const element& target, cascade<property_type>& candidates,
+    const ancestor_filter* ancestors = nullptr, std::uint32_t sheet = 0) const
+  {
+    return m_index.visit(target, ancestors,
+      [&](std::uint32_t rule) { candidates.add_rule(*m_rules[rule], sheet); });
+  }
+
+protected:
+  rule_index m_index;
+  std::vector<const rule_type*> m_rules;
+};
+
+} // namespace match
+} // namespace css
+
+#endif // css_match_index_h
@@ -0,0 +1,605 @@
+#ifndef css_match_selector_h
+#define css_match_selector_h
+#include "css/composite/grammar.h"
+#include "css/parser/atom.h"
+#include "css/parser/escape.h"
+#include "css/parser/state.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace css
+{
+
+/// Matching parsed selectors against a document.
+namespace match
+{
+
+/// An attribute of an element.
+struct attribute
+{
+  parser::atom name;      //!< The attribute's lower-case name.
+  std::string_view value; //!< The attribute's value.
+};
+
+/// What a selector needs to know about an element of a document.
+///
+/// Callers describe each element of their document tree with one of
+/// these; every atom must come from the atom table used to compile
+/// the selectors (e.g., the stylesheet's atoms()). Tag and attribute
+/// names are matched ASCII case-insensitively, so intern them in
+/// lower case; IDs and classes are case-sensitive. Note that the `id`
+/// and `class` attributes are only seen by attribute selectors when
+/// they are also listed in \a attributes.
+struct element
+{
+  parser::atom tag = parser::atom::none;
+  parser::atom id = parser::atom::none;
+  std::vector<parser::atom> classes;
+  std::vector<attribute> attributes;
+  /// The lower-case names of the pseudo-classes that apply (e.g., "hover").
+  std::vector<parser::atom> states;
+  const element* parent = nullptr;
+  const element* previous = nullptr; //!< The previous element sibling.
+  const element* next = nullptr;     //!< The next element sibling.
+};
+
+/// A selector compiled for matching.
+///
+/// Compounds are stored from right to left (the subject first); each
+/// holds a run of simple tests and the combinator that leads to the
+/// compound on its left. Attribute values are kept in a single string.
+class selector
+{
+public:
+  /// The kinds of simple tests.
+  enum class test_kind : std::uint8_t
+  {
+    type,        //!< The element's tag is \a name.
+    id,          //!< The element's ID is \a name.
+    class_,      //!< The element has the class \a name.
+    attribute,   //!< The element has an attribute \a name (see attribute_op).
+    first_child, //!< The element has no previous sibling.
+    last_child,  //!< The element has no next sibling.
+    only_child,  //!< The element has no siblings.
+    root,        //!< The element has no parent.
+    state        //!< The element lists the pseudo-class \a name in its states.
+  };
+
+  /// How an attribute test compares the attribute's value.
+  enum class attribute_op : std::uint8_t
+  {
+    exists,    //!< `[name]`
+    equal,     //!< `[name=value]`
+    includes,  //!< `[name~=value]`: one of the whitespace-separated words.
+    dashmatch, //!< `[name|=value]`: the value or a prefix followed by '-'.
+    prefix,    //!< `[name^=value]`
+    suffix,    //!< `[name$=value]`
+    substring  //!< `[name*=value]`
+  };
+
+  struct test
+  {
+    test_kind kind;
+    attribute_op op = attribute_op::exists;
+    bool ignore_case = false; //!< Compare attribute values ignoring ASCII case (the `i` flag).
+    parser::atom name = parser::atom::none;
+    std::uint32_t offset = 0; //!< Where an attribute test's value begins in values().
+    std::uint32_t length = 0; //!< The length of an attribute test's value.
+  };
+
+  struct compound
+  {
+    std::uint32_t first = 0; //!< The index of the compound's first test.
+    std::uint32_t count = 0; //!< The number of tests in the compound.
+    parser::combinator relation = parser::combinator::none; //!< The combinator on the compound's left (none for the leftmost).
+  };
+
+  /// The most ancestor hashes a selector keeps (see ancestor_hashes()).
+  static constexpr std::size_t max_ancestor_hashes = 4;
+
+  /// Hash a type, ID or class \a name for an ancestor_filter.
+  ///
+  /// The \a kind is mixed in so that, e.g., a tag and a class with the
+  /// same name hash differently. Only the low 24 bits are significant.
+  static std::uint32_t ancestor_hash(test_kind kind, parser::atom name)
+  {
+    std::uint32_t hash = static_cast<std::uint32_t>(name) * 4 + static_cast<std::uint32_t>(kind);
+    // The finalizer of MurmurHash3, since atoms are small consecutive numbers.
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+  }
+
+  /// Returns false when the text was not a selector or uses features
+  /// that cannot match elements (pseudo-elements and functional
+  /// pseudo-classes); such selectors never match.
+  bool valid() const { return m_valid; }
+
+  const std::vector<test>& tests() const { return m_tests; }
+  const std::vector<compound>& compounds() const { return m_compounds; }
+  const std::string& values() const { return m_values; }
+
+  /// Hashes of types, IDs and classes that every match's ancestors must have.
+  ///
+  /// These come from the compounds that must match an ancestor of the
+  /// subject (those left of a child or descendant combinator), IDs and
+  /// classes first; at most max_ancestor_hashes are kept. When an
+  /// ancestor_filter of the target's ancestors lacks any of them, the
+  /// selector cannot match without walking the ancestors.
+  const std::uint32_t* ancestor_hashes() const { return m_ancestor_hashes; }
+  std::size_t ancestor_hash_count() const { return m_ancestor_hash_count; }
+
+  /// Returns true when \a target matches the selector.
+  bool matches(const element& target) const
+  {
+    return m_valid && this->match_from(0, &target);
+  }
+
+protected:
+  template<typename Rule> friend struct compile_action;
+  friend struct selector_compiler;
+
+  bool match_from(std::size_t index, const element* target) const
+  {
+    for (;;)
+    {
+      if (!this->compound_matches(m_compounds[index], *target))
+      {
+        return false;
+      }
+      if (index + 1 == m_compounds.size())
+      {
+        return true;
+      }
+      switch (m_compounds[index].relation)
+      {
+      case parser::combinator::child:
+        target = target->parent;
+        break;
+      case parser::combinator::adjacent:
+        target = target->previous;
+        break;
+      default:
+        // Try every ancestor; only descendant combinators backtrack.
+        for (const element* ancestor = target->parent; ancestor; ancestor = ancestor->parent)
+        {
+          if (this->match_from(index + 1, ancestor))
+          {
+            return true;
+          }
+        }
+        return false;
+      }
+      if (!target)
+      {
+        return false;
+      }
+      ++index;
+    }
+  }
+
+  bool compound_matches(const compound& where, const element& target) const
+  {
+    for (std::uint32_t ii = where.first; ii < where.first + where.count; ++ii)
+    {
+      if (!this->test_matches(m_tests[ii], target))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool test_matches(const test& check, const element& target) const
+  {
+    switch (check.kind)
+    {
+    case test_kind::type:
+      return target.tag == check.name;
+    case test_kind::id:
+      return target.id == check.name;
+    case test_kind::class_:
+      return std::find(target.classes.begin(), target.classes.end(), check.name) != target.classes.end();
+    case test_kind::first_child:
+      return !target.previous;
+    case test_kind::last_child:
+      return !target.next;
+    case test_kind::only_child:
+      return !target.previous && !target.next;
+    case test_kind::root:
+      return !target.parent;
+    case test_kind::state:
+      return std::find(target.states.begin(), target.states.end(), check.name) != target.states.end();
+    case test_kind::attribute:
+      for (const auto& entry : target.attributes)
+      {
+        if (entry.name == check.name)
+        {
+          return this->value_matches(check, entry.value);
+        }
+      }
+      return false;
+    }
+    return false;
+  }
+
+  bool value_matches(const test& check, std::string_view value) const
+  {
+    const std::string_view expected(m_values.data() + check.offset, check.length);
+    auto same = [&check](std::string_view aa, std::string_view bb)
+    {
+      if (aa.size() != bb.size())
+      {
+        return false;
+      }
+      for (std::size_t ii = 0; ii < aa.size(); ++ii)
+      {
+        auto ca = static_cast<unsigned char>(aa[ii]);
+        auto cb = static_cast<unsigned char>(bb[ii]);
+        if (check.ignore_case && ca >= 'A' && ca <= 'Z')
+        {
+          ca |= 0x20;
+        }
+        if (check.ignore_case && cb >= 'A' && cb <= 'Z')
+        {
+          cb |= 0x20;
+        }
+        if (ca != cb)
+        {
+          return false;
+        }
+      }
+      return true;
+    };
+    switch (check.op)
+    {
+    case attribute_op::exists:
+      return true;
+    case attribute_op::equal:
+      return same(value, expected);
+    case attribute_op::includes:
+      for (std::size_t begin = 0; begin < value.size();)
+      {
+        std::size_t end = value.find_first_of(" \t\n\r\f", begin);
+        end = end == std::string_view::npos ? value.size() : end;
+        if (end > begin && !expected.empty() && same(value.substr(begin, end - begin), expected))
+        {
+          return true;
+        }
+        begin = end + 1;
+      }
+      return false;
+    case attribute_op::dashmatch:
+      return same(value, expected) ||
+        (value.size() > expected.size() && value[expected.size()] == '-' &&
+         same(value.substr(0, expected.size()), expected));
+    case attribute_op::prefix:
+      return !expected.empty() && value.size() >= expected.size() &&
+        same(value.substr(0, expected.size()), expected);
+    case attribute_op::suffix:
+      return !expected.empty() && value.size() >= expected.size() &&
+        same(value.substr(value.size() - expected.size()), expected);
+    case attribute_op::substring:
+      if (expected.empty())
+      {
+        return false;
+      }
+      for (std::size_t ii = 0; ii + expected.size() <= value.size(); ++ii)
+      {
+        if (same(value.substr(ii, expected.size()), expected))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+    return false;
+  }
+
+  /// Fill m_ancestor_hashes from the compounds (stored right to left).
+  void find_ancestor_hashes()
+  {
+    m_ancestor_hash_count = 0;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      for (std::size_t cc = 1; cc < m_compounds.size(); ++cc)
+      {
+        // Siblings share their parent, so only the combinator on a compound's right decides.
+        const auto relation = m_compounds[cc - 1].relation;
+        if (relation != parser::combinator::child && relation != parser::combinator::descendant)
+        {
+          continue;
+        }
+        const auto& where = m_compounds[cc];
+        for (std::uint32_t ii = where.first; ii < where.first + where.count; ++ii)
+        {
+          const auto& check = m_tests[ii];
+          const bool wanted = pass == 0 ?
+            (check.kind == test_kind::id || check.kind == test_kind::class_) :
+            check.kind == test_kind::type;
+          if (wanted && m_ancestor_hash_count < max_ancestor_hashes)
+          {
+            m_ancestor_hashes[m_ancestor_hash_count++] = selector::ancestor_hash(check.kind, check.name);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<test> m_tests;
+  std::vector<compound> m_compounds;
+  std::string m_values;
+  std::uint32_t m_ancestor_hashes[max_ancestor_hashes] = {};
+  std::uint8_t m_ancestor_hash_count = 0;
+  bool m_valid = false;
+};
+
+/// The state of compile() while the selector's text is parsed.
+struct selector_compiler
+{
+  selector result;
+  parser::atom_table* atoms;
+  std::uint32_t open = 0; //!< The first test of the compound being matched.
+  parser::combinator relation = parser::combinator::descendant;
+  bool supported = true;
+
+  /// Intern the identifier \a text (with escapes decoded), folding ASCII case when \a fold is true.
+  parser::atom intern(std::string_view text, bool fold)
+  {
+    std::string name = parser::has_escapes(text) ? parser::unescape(text) : std::string(text);
+    if (fold)
+    {
+      for (auto& cc : name)
+      {
+        cc = (cc >= 'A' && cc <= 'Z') ? static_cast<char>(cc | 0x20) : cc;
+      }
+    }
+    return this->atoms->intern(name);
+  }
+
+  void add(selector::test_kind kind, parser::atom name)
+  {
+    selector::test check;
+    check.kind = kind;
+    check.name = name;
+    this->result.m_tests.push_back(check);
+  }
+
+  /// Return the compiled selector (invalid unless \a parsed).
+  selector finish(bool parsed)
+  {
+    auto& compounds = this->result.m_compounds;
+    if (!parsed || !this->supported || compounds.empty())
+    {
+      return selector();
+    }
+    // Each compound recorded the combinator to its left, which (right to
+    // left) leads from it to the next compound; the last leads nowhere.
+    std::reverse(compounds.begin(), compounds.end());
+    compounds.back().relation = parser::combinator::none;
+    this->result.find_ancestor_hashes();
+    this->result.m_valid = true;
+    return std::move(this->result);
+  }
+};
+
+/// Actions that compile the parts of a selector into a selector_compiler.
+template<typename Rule>
+struct compile_action : rule::nothing<Rule>
+{
+};
+
+template<>
+struct compile_action<composite::element_name>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    if (*in.begin() != '*')
+    {
+      state.add(selector::test_kind::type, state.intern(std::string_view(in.begin(), in.size()), true));
+    }
+  }
+};
+
+template<>
+struct compile_action<composite::class_modifier>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    state.add(selector::test_kind::class_, state.intern(std::string_view(in.begin() + 1, in.size() - 1), false));
+  }
+};
+
+template<>
+struct compile_action<composite::selector_modifier>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    // Classes, attributes and pseudo-classes have their own actions.
+    if (*in.begin() == '#')
+    {
+      state.add(selector::test_kind::id, state.intern(std::string_view(in.begin() + 1, in.size() - 1), false));
+    }
+  }
+};
+
+template<>
+struct compile_action<composite::attrib>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    // The grammar has checked the form `[name op value flag]`, so only its pieces need finding.
+    const std::string_view text(in.begin(), in.size());
+    auto blank = [](char cc) { return cc == ' ' || cc == '\t' || cc == '\n' || cc == '\r' || cc == '\f'; };
+    std::size_t ii = 1;
+    while (blank(text[ii]))
+    {
+      ++ii;
+    }
+    std::size_t name = ii;
+    while (text[ii] != ']' && !blank(text[ii]) && std::string_view("=~|^$*").find(text[ii]) == std::string_view::npos)
+    {
+      ii += text[ii] == '\\' ? 2 : 1;
+    }
+    selector::test check;
+    check.kind = selector::test_kind::attribute;
+    check.name = state.intern(text.substr(name, ii - name), true);
+    while (blank(text[ii]))
+    {
+      ++ii;
+    }
+    if (text[ii] != ']')
+    {
+      switch (text[ii])
+      {
+      case '=': check.op = selector::attribute_op::equal; break;
+      case '~': check.op = selector::attribute_op::includes; break;
+      case '|': check.op = selector::attribute_op::dashmatch; break;
+      case '^': check.op = selector::attribute_op::prefix; break;
+      case '$': check.op = selector::attribute_op::suffix; break;
+      default: check.op = selector::attribute_op::substring; break;
+      }
+      ii += text[ii] == '=' ? 1 : 2;
+      while (blank(text[ii]))
+      {
+        ++ii;
+      }
+      std::size_t value = ii;
+      std::string decoded;
+      if (text[ii] == '"' || text[ii] == '\'')
+      {
+        const char quote = text[ii];
+        for (++ii; text[ii] != quote; ++ii)
+        {
+          ii += text[ii] == '\\' ? 1 : 0;
+        }
+        ++ii;
+        decoded = parser::unescape(text.substr(value + 1, ii - value - 2));
+      }
+      else
+      {
+        while (text[ii] != ']' && !blank(text[ii]))
+        {
+          ii += text[ii] == '\\' ? 2 : 1;
+        }
+        decoded = parser::unescape(text.substr(value, ii - value));
+      }
+      while (blank(text[ii]))
+      {
+        ++ii;
+      }
+      check.ignore_case = text[ii] == 'i';
+      check.offset = static_cast<std::uint32_t>(state.result.m_values.size());
+      check.length = static_cast<std::uint32_t>(decoded.size());
+      state.result.m_values += decoded;
+    }
+    state.result.m_tests.push_back(check);
+  }
+};
+
+template<>
+struct compile_action<composite::pseudo>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    std::string_view text(in.begin(), in.size());
+    const bool element = text.size() > 1 && text[1] == ':';
+    text.remove_prefix(element ? 2 : 1);
+    // Functional pseudo-classes and pseudo-elements never match elements.
+    if (element || text.find('(') != std::string_view::npos)
+    {
+      state.supported = false;
+      return;
+    }
+    const parser::atom name = state.intern(text, true);
+    const std::string_view folded = state.atoms->text(name);
+    if (folded == "before" || folded == "after" || folded == "first-line" || folded == "first-letter")
+    {
+      // Pseudo-elements that may be written with a single colon.
+      state.supported = false;
+    }
+    else if (folded == "first-child")
+    {
+      state.add(selector::test_kind::first_child, name);
+    }
+    else if (folded == "last-child")
+    {
+      state.add(selector::test_kind::last_child, name);
+    }
+    else if (folded == "only-child")
+    {
+      state.add(selector::test_kind::only_child, name);
+    }
+    else if (folded == "root")
+    {
+      state.add(selector::test_kind::root, name);
+    }
+    else
+    {
+      state.add(selector::test_kind::state, name);
+    }
+  }
+};
+
+template<>
+struct compile_action<composite::combinator>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    state.relation = *in.begin() == '>' ? parser::combinator::child : parser::combinator::adjacent;
+  }
+};
+
+template<>
+struct compile_action<composite::simple_selector>
+{
+  template<typename Input>
+  static void apply(const Input& in, selector_compiler& state)
+  {
+    (void)in;
+    selector::compound entry;
+    entry.first = state.open;
+    entry.count = static_cast<std::uint32_t>(state.result.m_tests.size()) - state.open;
+    entry.relation = state.relation;
+    state.result.m_compounds.push_back(entry);
+    state.open = static_cast<std::uint32_t>(state.result.m_tests.size());
+    state.relation = parser::combinator::descendant;
+  }
+};
+
+/// Compile the text of a single selector (e.g., a key of
+/// basic_stylesheet::properties), interning its names in \a atoms.
+inline selector compile(std::string_view text, parser::atom_table& atoms = parser::atom_table::global())
+{
+  selector_compiler state;
+  state.atoms = &atoms;
+  rule::memory_input<> in(text.data(), text.size(), "selector");
+  bool parsed = false;
+  try
+  {
+    parsed = rule::parse<rule::seq<composite::selector, token::optional_whitespace, rule::eof>, compile_action>(in, state);
+  }
+  catch (rule::parse_error&)
+  {
+    parsed = false;
+  }
+  return state.finish(parsed);
+}
+
+} // namespace match
+} // namespace css
+
+#endif // css_match_selector_h
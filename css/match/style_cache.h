@@ -0,0 +1,188 @@
+#ifndef css_match_style_cache_h
+#define css_match_style_cache_h
+#include "css/match/index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace css
+{
+namespace match
+{
+
+/// The winning declaration of each property that applies to an element.
+///
+/// Computed styles are immutable and may be shared by many elements;
+/// a style's address identifies it (see style_cache).
+template<typename Property>
+struct computed_style
+{
+  std::vector<const Property*> declarations; //!< See cascade::resolve().
+};
+
+/// A cache of computed styles shared by elements that must match the same rules.
+///
+/// Two elements match the same rules when they look the same to every
+/// selector: the same tag, ID, classes, attributes, pseudo-class
+/// states and first/last-child status, the same parent style, and the
+/// same previous siblings (as far back as any selector's run of `+`
+/// combinators reaches; see rule_index::sibling_depth()). The parent
+/// style stands in for every ancestor since, by induction, elements
+/// only share a style when their ancestors look the same. So siblings
+/// in a list (and their descendants) resolve their style once.
+///
+/// Styles are looked up by that signature; the least recently used
+/// entry is evicted once there are more than capacity(). Computed
+/// styles refer to the declarations of the rules, which must outlive
+/// the cache and every style it returns.
+template<typename Sheet>
+class style_cache
+{
+public:
+  using property_type = typename Sheet::property_type;
+  using style_type = computed_style<property_type>;
+  using style_pointer = std::shared_ptr<const style_type>;
+
+  explicit style_cache(const stylesheet_rules<Sheet>& rules, std::size_t capacity = 1024)
+    : m_rules(rules)
+    , m_capacity(capacity ? capacity : 1)
+  {
+  }
+
+  /// Return the style of \a target, whose parent's style is \a parent (null for the root).
+  ///
+  /// Pass the \a ancestors of \a target to speed up matching on a miss.
+  style_pointer style(const element& target, const style_pointer& parent, const ancestor_filter* ancestors = nullptr)
+  {
+    m_key.clear();
+    this->append_signature(target, parent.get());
+    auto found = m_entries.find(m_key);
+    if (found != m_entries.end())
+    {
+      ++m_hits;
+      // Move the entry to the front of the recently-used list.
+      m_order.splice(m_order.begin(), m_order, found->second);
+      return found->second->style;
+    }
+    ++m_misses;
+    m_cascade.clear();
+    m_rules.apply(target, m_cascade, ancestors);
+    auto computed = std::make_shared<style_type>();
+    computed->declarations = m_cascade.resolve();
+    m_order.push_front(entry{ m_key, computed, parent });
+    m_entries.emplace(m_order.front().key, m_order.begin());
+    if (m_order.size() > m_capacity)
+    {
+      m_entries.erase(m_order.back().key);
+      m_order.pop_back();
+    }
+    return computed;
+  }
+
+  /// The number of styles found in the cache.
+  std::size_t hits() const { return m_hits; }
+  /// The number of styles that had to be matched and resolved.
+  std::size_t misses() const { return m_misses; }
+  /// The fraction of styles found in the cache (0 before any lookup).
+  double hit_rate() const
+  {
+    const std::size_t total = m_hits + m_misses;
+    return total ? static_cast<double>(m_hits) / static_cast<double>(total) : 0.0;
+  }
+
+  /// The number of styles cached.
+  std::size_t size() const { return m_order.size(); }
+  /// The most styles cached at once.
+  std::size_t capacity() const { return m_capacity; }
+
+  /// Forget every cached style (but keep the counters).
+  void clear()
+  {
+    m_entries.clear();
+    m_order.clear();
+  }
+
+protected:
+  struct entry
+  {
+    std::string key;
+    style_pointer style;
+    /// Holding the parent style keeps its address (part of the key) from being reused.
+    style_pointer parent;
+  };
+
+  template<typename Value>
+  void append(const Value& value)
+  {
+    m_key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  /// Append what selectors can see of \a target (and its previous siblings) to m_key.
+  void append_signature(const element& target, const style_type* parent)
+  {
+    this->append(parent);
+    const element* sibling = &target;
+    for (std::size_t depth = 0; sibling && depth <= m_rules.index().sibling_depth(); ++depth)
+    {
+      this->append_element(*sibling);
+      sibling = sibling->previous;
+    }
+    // Mark where the siblings ran out so shorter runs cannot look like longer ones.
+    this->append(static_cast<std::uint8_t>(0xff));
+  }
+
+  void append_element(const element& target)
+  {
+    const std::uint8_t flags = (target.previous ? 1 : 0) | (target.next ? 2 : 0);
+    this->append(flags);
+    this->append(target.tag);
+    this->append(target.id);
+    // Classes, attributes and states match regardless of their order.
+    this->append_set(target.classes);
+    m_attributes.assign(target.attributes.begin(), target.attributes.end());
+    std::sort(m_attributes.begin(), m_attributes.end(),
+      [](const attribute& aa, const attribute& bb) { return aa.name < bb.name; });
+    this->append(static_cast<std::uint32_t>(m_attributes.size()));
+    for (const auto& each : m_attributes)
+    {
+      this->append(each.name);
+      this->append(static_cast<std::uint32_t>(each.value.size()));
+      m_key.append(each.value.data(), each.value.size());
+    }
+    this->append_set(target.states);
+  }
+
+  void append_set(const std::vector<parser::atom>& names)
+  {
+    m_names.assign(names.begin(), names.end());
+    std::sort(m_names.begin(), m_names.end());
+    m_names.erase(std::unique(m_names.begin(), m_names.end()), m_names.end());
+    this->append(static_cast<std::uint32_t>(m_names.size()));
+    for (parser::atom name : m_names)
+    {
+      this->append(name);
+    }
+  }
+
+  const stylesheet_rules<Sheet>& m_rules;
+  std::size_t m_capacity;
+  std::list<entry> m_order; //!< Entries from most to least recently used.
+  std::unordered_map<std::string, typename std::list<entry>::iterator> m_entries;
+  cascade<property_type> m_cascade;
+  std::string m_key;
+  std::vector<parser::atom> m_names;
+  std::vector<attribute> m_attributes;
+  std::size_t m_hits = 0;
+  std::size_t m_misses = 0;
+};
+
+} // namespace match
+} // namespace css
+
+#endif // css_match_style_cache_h
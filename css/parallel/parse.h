@@ -0,0 +1,232 @@
+#ifndef css_parallel_parse_h
+#define css_parallel_parse_h
+#include "css/parser/actions.h"
+#include "css/parser/arena.h"
+
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace css
+{
+
+/// Parse a single stylesheet on several threads.
+///
+/// The input is first split (by boundaries()) into chunks that each
+/// end after a top-level ruleset, media block or page block. The
+/// first chunk is parsed with composite::stylesheet (so it holds any
+/// `@charset` and `@import` rules) and the rest with parallel::chunk,
+/// each into its own stylesheet. The chunk stylesheets are then merged
+/// in source order, so the result is identical to a serial parse.
+namespace parallel
+{
+
+/// The tail of a stylesheet that starts at a top-level rule boundary.
+struct chunk :
+  rule::seq<
+    rule::star<
+      rule::sor<
+        token::whitespace,
+        token::CDO,
+        token::CDC
+      >
+    >,
+    rule::star<
+      token::dispatch_sor<
+        composite::ruleset,
+        composite::media,
+        composite::page
+      >,
+      rule::star<
+        rule::sor<
+          rule::seq<
+            token::CDO,
+            token::optional_whitespace
+          >,
+          rule::seq<
+            token::CDC,
+            token::optional_whitespace
+          >
+        >
+      >
+    >,
+    rule::eof
+  >
+{
+};
+
+/// Return the offsets at which \a text may be split into chunks of
+/// roughly \a target bytes, each beginning at a top-level rule boundary.
+///
+/// The scan skips comments, strings, escaped characters and the
+/// contents of parentheses (e.g., unquoted `url()` values) so that it
+/// only splits after a `}` that closes a top-level block. The first
+/// offset is always 0.
+inline std::vector<std::size_t> boundaries(std::string_view text, std::size_t target)
+{
+  std::vector<std::size_t> result{ 0 };
+  std::size_t depth = 0;
+  std::size_t parens = 0;
+  std::size_t next = target;
+  const std::size_t size = text.size();
+  for (std::size_t ii = 0; ii < size; ++ii)
+  {
+    switch (text[ii])
+    {
+      case '\\':
+        ++ii;
+        break;
+      case '"':
+      case '\'':
+        {
+          const char delimiter = text[ii];
+          for (++ii; ii < size && text[ii] != delimiter; ++ii)
+          {
+            if (text[ii] == '\\')
+            {
+              ++ii;
+            }
+          }
+        }
+        break;
+      case '/':
+        if (ii + 1 < size && text[ii + 1] == '*')
+        {
+          std::size_t close = text.find("*/", ii + 2);
+          if (close == std::string_view::npos)
+          {
+            // An unterminated comment runs to the end of the input.
+            return result;
+          }
+          ii = close + 1;
+        }
+        break;
+      case '(':
+        ++parens;
+        break;
+      case ')':
+        if (parens > 0)
+        {
+          --parens;
+        }
+        break;
+      case '{':
+        if (parens == 0)
+        {
+          ++depth;
+        }
+        break;
+      case '}':
+        if (parens == 0 && depth > 0 && --depth == 0 && ii + 1 >= next && ii + 1 < size)
+        {
+          result.push_back(ii + 1);
+          next = ii + 1 + target;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return result;
+}
+
+/// Parse \a size bytes at \a data into \a sheet using up to \a threads threads.
+///
+/// When \a threads is 0, the hardware concurrency is used. When
+/// \a chunk_size is 0, chunks are sized so each thread parses several.
+/// If any chunk fails to parse, the whole input is reparsed serially
+/// so that the result (and any parse_error thrown) matches a serial
+/// parse exactly. Returns the result of the parse.
+///
+/// Stylesheets storing views (e.g., stylesheet_view) refer to \a data,
+/// which must outlive \a sheet. Note that when `CSS_DBG_PARSE` is
+/// enabled, the debug output of the threads is interleaved.
+template<typename Sheet>
+bool parse(const char* data, std::size_t size, const std::string& source, Sheet& sheet,
+  unsigned threads = 0, std::size_t chunk_size = 0)
+{
+  if (threads == 0)
+  {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (chunk_size == 0)
+  {
+    chunk_size = std::max<std::size_t>(64 * 1024, size / (4 * threads));
+  }
+  std::vector<std::size_t> starts = boundaries(std::string_view(data, size), chunk_size);
+  const std::size_t count = starts.size();
+  starts.push_back(size);
+
+  auto serial = [&]()
+  {
+    rule::memory_input<> in(data, size, source);
+    return rule::parse<composite::stylesheet, parser::action>(in, sheet);
+  };
+  if (count == 1 || threads == 1)
+  {
+    return serial();
+  }
+
+  // Each chunk gets its own arena; they are only read (by merge()) once all threads finish.
+  std::vector<std::unique_ptr<parser::arena>> arenas;
+  std::vector<std::unique_ptr<Sheet>> sheets;
+  for (std::size_t ii = 0; ii < count; ++ii)
+  {
+    arenas.emplace_back(new parser::arena);
+    sheets.emplace_back(new Sheet(arenas.back()->resource()));
+    sheets.back()->expand_shorthands = sheet.expand_shorthands;
+    sheets.back()->source = sheet.source;
+    sheets.back()->accumulate.atoms = sheet.accumulate.atoms;
+  }
+  std::vector<char> parsed(count, false);
+  std::atomic<std::size_t> next{ 0 };
+  auto work = [&]()
+  {
+    for (std::size_t ii = next++; ii < count; ii = next++)
+    {
+      rule::memory_input<> in(data + starts[ii], data + starts[ii + 1], source);
+      try
+      {
+        parsed[ii] = ii == 0 ?
+          rule::parse<composite::stylesheet, parser::action>(in, *sheets[ii]) :
+          rule::parse<parallel::chunk, parser::action>(in, *sheets[ii]);
+      }
+      catch (std::exception&)
+      {
+        parsed[ii] = false;
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned ii = 1; ii < std::min<std::size_t>(threads, count); ++ii)
+  {
+    pool.emplace_back(work);
+  }
+  work();
+  for (auto& thread : pool)
+  {
+    thread.join();
+  }
+
+  if (std::find(parsed.begin(), parsed.end(), false) != parsed.end())
+  {
+    sheets.clear();
+    return serial();
+  }
+  sheet.encoding = sheets.front()->encoding;
+  for (const auto& piece : sheets)
+  {
+    sheet.merge(*piece);
+  }
+  return true;
+}
+
+} // parallel namespace
+} // css namespace
+
+#endif // css_parallel_parse_h
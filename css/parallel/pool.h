@@ -0,0 +1,171 @@
+#ifndef css_parallel_pool_h
+#define css_parallel_pool_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace css
+{
+namespace parallel
+{
+
+/// A work-stealing thread pool.
+///
+/// Each worker owns a queue of tasks. Workers take tasks from the back
+/// of their own queue and, when it is empty, steal from the front of
+/// other workers' queues, so uneven task sizes (e.g., files of very
+/// different lengths) still keep every core busy.
+///
+/// Tasks are passed the index of the worker running them, which may
+/// be used to look up per-thread state (such as an arena) that is
+/// reused across tasks.
+class pool
+{
+public:
+  using task = std::function<void(unsigned worker)>;
+
+  /// Start \a threads workers (0 for the hardware concurrency).
+  explicit pool(unsigned threads = 0)
+  {
+    if (threads == 0)
+    {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned ii = 0; ii < threads; ++ii)
+    {
+      m_queues.emplace_back(new queue);
+    }
+    for (unsigned ii = 0; ii < threads; ++ii)
+    {
+      m_threads.emplace_back([this, ii]() { this->run(ii); });
+    }
+  }
+  pool(const pool&) = delete;
+  pool& operator = (const pool&) = delete;
+
+  /// Finish all submitted tasks and stop the workers.
+  ~pool()
+  {
+    this->wait();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads)
+    {
+      thread.join();
+    }
+  }
+
+  /// The number of worker threads.
+  unsigned size() const { return static_cast<unsigned>(m_queues.size()); }
+
+  /// Queue \a work to be run by some worker.
+  void submit(task work)
+  {
+    auto& target = *m_queues[m_next++ % m_queues.size()];
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      {
+        std::lock_guard<std::mutex> queued(target.mutex);
+        target.tasks.push_back(std::move(work));
+      }
+      ++m_queued;
+      ++m_pending;
+    }
+    m_wake.notify_one();
+  }
+
+  /// Block until every submitted task has finished.
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_pending == 0; });
+  }
+
+protected:
+  struct queue
+  {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  };
+
+  /// Take a task from worker \a ii's queue or steal one from another worker.
+  bool take(unsigned ii, task& work)
+  {
+    {
+      auto& own = *m_queues[ii];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty())
+      {
+        work = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    for (std::size_t offset = 1; offset < m_queues.size(); ++offset)
+    {
+      auto& victim = *m_queues[(ii + offset) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty())
+      {
+        work = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(unsigned ii)
+  {
+    task work;
+    for (;;)
+    {
+      if (this->take(ii, work))
+      {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          --m_queued;
+        }
+        work(ii);
+        work = nullptr;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_pending == 0)
+        {
+          m_idle.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this]() { return m_stopping || m_queued > 0; });
+      if (m_stopping && m_queued == 0)
+      {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<queue>> m_queues;
+  std::vector<std::thread> m_threads;
+  std::atomic<std::size_t> m_next{ 0 };
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_idle;
+  std::size_t m_queued = 0;  //!< Tasks submitted but not yet taken by a worker.
+  std::size_t m_pending = 0; //!< Tasks submitted but not yet finished.
+  bool m_stopping = false;
+};
+
+} // parallel namespace
+} // css namespace
+
+#endif // css_parallel_pool_h
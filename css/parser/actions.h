@@ -1,6 +1,7 @@
 #ifndef css_parser_actions_h
 #define css_parser_actions_h
 #include "css/composite/grammar.h"
+#include "css/parser/number.h"
 #include "css/parser/state.h"
 
 namespace css
@@ -12,6 +13,9 @@ namespace parser
 ///
 /// Note that when the `CSS_DBG_PARSE` macro is defined, this action will
 /// print all matches, which is useful when debugging failures to match.
+///
+/// Actions accept any basic_stylesheet; a stylesheet_view stores
+/// text that refers to the input instead of copying it.
 template<typename Rule>
 struct action
 #if !CSS_DBG_PARSE
@@ -19,10 +23,10 @@ struct action
 #endif
 {
 #if CSS_DBG_PARSE
-  template< typename Input >
+  template< typename Input, typename Sheet >
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
     (void)sheet;
     std::cout << "Token " << typeName<Rule>() << " match \"" << in.string() << "\"\n";
@@ -34,58 +38,253 @@ struct action
 template<>
 struct action<token::encoding_charset>
 {
-  template< typename Input >
+  template< typename Input, typename Sheet >
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
-    sheet.encoding = in.string().substr(1, in.string().size() - 2);
+    // Strip the quotation marks.
+    sheet.encoding.assign(in.begin() + 1, in.size() - 2);
   }
 };
 
 template<>
 struct action<composite::selector>
 {
-  template<typename Input>
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    sheet.accumulate.add_selector(in.begin(), sheet.text(in.begin(), in.end()));
+    sheet.accumulate.end_selector(in.begin());
+  }
+};
+
+template<>
+struct action<composite::simple_selector>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    sheet.accumulate.add_compound(in.begin(), in.end());
+  }
+};
+
+template<>
+struct action<composite::combinator>
+{
+  template<typename Input, typename Sheet>
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
-    sheet.accumulate.selector = in.string();
+    sheet.accumulate.relation = *in.begin() == '>' ? combinator::child : combinator::adjacent;
   }
 };
 
 template<>
 struct action<composite::property>
 {
-  template<typename Input>
+  template<typename Input, typename Sheet>
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
-    sheet.accumulate.prop.name = in.string();
+    sheet.accumulate.prop.name = sheet.identifier(in.begin(), in.end());
+    sheet.accumulate.prop.id = property_from_name(sheet.accumulate.prop.name);
+    sheet.accumulate.components.clear();
   }
 };
 
 template<>
 struct action<composite::property_value>
 {
-  template<typename Input>
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    sheet.accumulate.prop.value = sheet.text(in.begin(), in.end());
+    sheet.accumulate.finish_value(in.begin(), in.end());
+  }
+};
+
+// Value components.
+//
+// Each term of a value adds a component to the accumulator as it is
+// matched; action<composite::property_value> then stores those inside
+// the value in the property (see basic_property::typed).
+
+template<token::numeric_kind Kind, typename Suffix>
+struct action<token::unit<Kind, Suffix>>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    sheet.accumulate.suffix_kind = Kind;
+    sheet.accumulate.suffix = in.begin();
+  }
+};
+
+template<>
+struct action<token::number>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    sheet.accumulate.number = to_number(in.begin(), in.end());
+  }
+};
+
+template<>
+struct action<token::numeric>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    const char* suffix = sheet.accumulate.suffix;
+    component item;
+    item.type = value_type::number;
+    item.number = sheet.accumulate.number;
+    switch (sheet.accumulate.suffix_kind)
+    {
+    case token::numeric_kind::number:
+      item.units = unit::none;
+      break;
+    case token::numeric_kind::percentage:
+      item.units = unit::percent;
+      break;
+    case token::numeric_kind::dimension:
+      item.units = unit::other;
+      break;
+    default:
+      // token::dimension_unit lists the same units as parser::unit, starting at unit::px.
+      static_assert(static_cast<int>(unit::khz) - static_cast<int>(unit::px) == static_cast<int>(token::dimension_unit::khz),
+        "token::dimension_unit and parser::unit must list units in the same order");
+      item.units = static_cast<unit>(static_cast<int>(unit::px) + static_cast<int>(
+        token::length_units::value(std::string_view(suffix, static_cast<std::size_t>(in.end() - suffix)))));
+      break;
+    }
+    sheet.accumulate.add_component(in.begin(), in.end(), item);
+  }
+};
+
+template<>
+struct action<token::hash>
+{
+  template<typename Input, typename Sheet>
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
-    sheet.accumulate.prop.value = in.string();
+    sheet.accumulate.token_end = in.end();
+  }
+};
+
+template<>
+struct action<token::hexcolor>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    // The match includes trailing whitespace; action<token::hash> recorded where the hash ends.
+    const char* end = sheet.accumulate.token_end;
+    component item;
+    item.type = parse_hex_color(std::string_view(in.begin() + 1, static_cast<std::size_t>(end - in.begin() - 1)), item.rgba) ?
+      value_type::color : value_type::hash;
+    sheet.accumulate.add_component(in.begin(), end, item);
+  }
+};
+
+template<>
+struct action<token::ident>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    component item;
+    item.word = keyword_from_ident(std::string_view(in.begin(), in.size()));
+    item.type = item.word == keyword::unknown ? value_type::ident : value_type::keyword;
+    sheet.accumulate.add_component(in.begin(), in.end(), item);
+  }
+};
+
+template<>
+struct action<token::string>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    component item;
+    item.type = value_type::string;
+    sheet.accumulate.add_component(in.begin(), in.end(), item);
+  }
+};
+
+template<>
+struct action<token::url>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    component item;
+    item.type = value_type::url;
+    sheet.accumulate.add_component(in.begin(), in.end(), item);
+  }
+};
+
+template<>
+struct action<composite::function_close>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    sheet.accumulate.token_end = in.end();
+  }
+};
+
+template<>
+struct action<composite::function>
+{
+  template<typename Input, typename Sheet>
+  static void apply(
+    const Input& in,
+    Sheet& sheet)
+  {
+    // The match includes trailing whitespace; action<composite::function_close>
+    // recorded where the call ends. Components of the arguments are replaced.
+    component item;
+    item.type = value_type::function;
+    sheet.accumulate.add_component(in.begin(), sheet.accumulate.token_end, item);
   }
 };
 
 template<>
 struct action<composite::important>
 {
-  template<typename Input>
+  template<typename Input, typename Sheet>
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
     sheet.accumulate.prop.important = true;
   }
@@ -94,15 +293,20 @@ struct action<composite::important>
 template<>
 struct action<composite::declaration>
 {
-  template<typename Input>
+  template<typename Input, typename Sheet>
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
     (void)in;
     if (sheet.accumulate.prop.is_set())
     {
-      sheet.accumulate.properties.insert(sheet.accumulate.prop);
+      sheet.accumulate.prop.source = sheet.source;
+      sheet.accumulate.prop.order = sheet.accumulate.declarations++;
+      if (!sheet.expand_shorthands || !sheet.accumulate.expand_shorthand())
+      {
+        sheet.accumulate.properties.insert(std::move(sheet.accumulate.prop));
+      }
       sheet.accumulate.prop.clear();
     }
   }
@@ -111,15 +315,29 @@ struct action<composite::declaration>
 template<>
 struct action<composite::ruleset>
 {
-  template<typename Input>
+  template<typename Input, typename Sheet>
   static void apply(
     const Input& in,
-    stylesheet& sheet)
+    Sheet& sheet)
   {
-    sheet.accumulate.properties.visit(
-      [&sheet](const property& p) { sheet.properties[sheet.accumulate.selector].insert(p); }
-    );
-    sheet.accumulate.properties.clear();
+    // Drop selectors and compounds recorded by selectors that were not part of this ruleset.
+    sheet.accumulate.keep_ruleset(in.begin());
+    auto& selectors = sheet.accumulate.selectors;
+    if (!sheet.accumulate.properties.empty())
+    {
+      // Every selector in the list shares one block of declarations.
+      std::uint32_t shift = 0;
+      auto block = sheet.share(std::move(sheet.accumulate.properties), shift);
+      for (const auto& entry : selectors)
+      {
+        sheet.add_rule(entry.text, entry.specificity, block, shift);
+      }
+      sheet.release(block);
+      sheet.accumulate.properties.clear();
+    }
+    sheet.accumulate.end_ruleset();
+    // Identifiers in selectors (and in rulesets without declarations) are recorded as components too.
+    sheet.accumulate.components.clear();
   }
 };
 #endif // !CSS_DBG_PARSE
@@ -0,0 +1,94 @@
+#ifndef css_parser_arena_h
+#define css_parser_arena_h
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace css
+{
+namespace parser
+{
+
+/// A memory resource that counts the requests it forwards upstream.
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+    : m_upstream(upstream)
+  {
+  }
+
+  /// The number of allocations requested.
+  std::size_t allocations() const { return m_allocations; }
+  /// The number of deallocations requested.
+  std::size_t deallocations() const { return m_deallocations; }
+  /// The total number of bytes requested (ignoring deallocations).
+  std::size_t bytes() const { return m_bytes; }
+
+protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    ++m_allocations;
+    m_bytes += bytes;
+    return m_upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+  {
+    ++m_deallocations;
+    m_upstream->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* m_upstream;
+  std::size_t m_allocations = 0;
+  std::size_t m_deallocations = 0;
+  std::size_t m_bytes = 0;
+};
+
+/// A monotonic arena from which a parse result may be allocated.
+///
+/// Allocations are carved sequentially out of a few large blocks
+/// obtained from the upstream resource, deallocation is a no-op, and
+/// every block is released at once when the arena is destroyed.
+/// The arena must outlive any stylesheet that allocates from it.
+/// It is not thread-safe.
+class arena
+{
+public:
+  explicit arena(
+    std::size_t initial_size = 64 * 1024,
+    std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+    : m_blocks(upstream)
+    , m_monotonic(initial_size, &m_blocks)
+    , m_requests(&m_monotonic)
+  {
+  }
+  arena(const arena&) = delete;
+  arena& operator = (const arena&) = delete;
+
+  /// The resource to pass to a basic_stylesheet.
+  std::pmr::memory_resource* resource() { return &m_requests; }
+
+  /// Counts of the allocations requested by containers using the arena.
+  const counting_resource& requests() const { return m_requests; }
+  /// Counts of the blocks the arena obtained from its upstream resource.
+  const counting_resource& blocks() const { return m_blocks; }
+
+  /// Return every block to the upstream resource so the arena may be reused.
+  ///
+  /// Anything allocated from the arena must be destroyed first.
+  void release() { m_monotonic.release(); }
+
+protected:
+  counting_resource m_blocks;
+  std::pmr::monotonic_buffer_resource m_monotonic;
+  counting_resource m_requests;
+};
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_arena_h
@@ -0,0 +1,262 @@
+#ifndef css_parser_atom_h
+#define css_parser_atom_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace css
+{
+namespace parser
+{
+
+/// An interned string (see css::parser::atom_table).
+///
+/// Equal strings interned in the same table have equal atoms, so
+/// identifiers can be compared and hashed as 32-bit integers. The
+/// empty string is always atom::none.
+enum class atom : std::uint32_t
+{
+  none = 0
+};
+
+/// A thread-safe table of interned strings.
+///
+/// Looking up a string that is already interned (and converting an
+/// atom back to its text) never locks: readers probe an
+/// open-addressing table of (hash, atom) pairs whose slots are only
+/// ever filled, never changed, and whose text is published before the
+/// slot. Interning a new string takes a mutex; when the table grows,
+/// it is copied to a larger one and the old one is kept (rather than
+/// freed) for readers that may still be probing it.
+///
+/// Text is copied into large blocks owned by the table and lives as
+/// long as the table does; atoms are never removed.
+class atom_table
+{
+public:
+  atom_table()
+  {
+    m_tables.emplace_back(new table(64));
+    m_table.store(m_tables.back().get(), std::memory_order_relaxed);
+  }
+  atom_table(const atom_table&) = delete;
+  atom_table& operator = (const atom_table&) = delete;
+  ~atom_table()
+  {
+    for (auto& segment : m_segments)
+    {
+      delete[] segment.load(std::memory_order_relaxed);
+    }
+  }
+
+  /// The table shared by every stylesheet that does not provide its own.
+  static atom_table& global()
+  {
+    static atom_table table;
+    return table;
+  }
+
+  /// Return the atom for \a text, interning it if needed.
+  atom intern(std::string_view text)
+  {
+    if (text.empty())
+    {
+      return atom::none;
+    }
+    const std::uint32_t hashed = atom_table::hash(text);
+    atom found = this->probe(*m_table.load(std::memory_order_acquire), hashed, text);
+    if (found != atom::none)
+    {
+      return found;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    table* current = m_table.load(std::memory_order_relaxed);
+    found = this->probe(*current, hashed, text);
+    if (found != atom::none)
+    {
+      return found;
+    }
+    const std::uint32_t count = m_size.load(std::memory_order_relaxed);
+    if (2 * (count + 1) > current->slots.size())
+    {
+      current = this->grow(*current);
+    }
+    found = static_cast<atom>(count + 1);
+    *this->entry(count + 1, true) = this->store(text);
+    m_bytes += text.size();
+    m_size.store(count + 1, std::memory_order_release);
+    this->place(*current, hashed, found);
+    return found;
+  }
+
+  /// Return the atom for \a text, or atom::none when it has not been interned.
+  atom find(std::string_view text) const
+  {
+    if (text.empty())
+    {
+      return atom::none;
+    }
+    return this->probe(*m_table.load(std::memory_order_acquire), atom_table::hash(text), text);
+  }
+
+  /// Return the text of \a name (which must come from this table).
+  std::string_view text(atom name) const
+  {
+    if (name == atom::none)
+    {
+      return std::string_view();
+    }
+    return *this->entry(static_cast<std::uint32_t>(name), false);
+  }
+
+  /// The number of atoms (not counting atom::none).
+  std::size_t size() const
+  {
+    return m_size.load(std::memory_order_acquire);
+  }
+
+  /// The number of bytes of text stored (once per atom).
+  std::size_t bytes() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+  }
+
+protected:
+  /// An open-addressing table of (hash << 32 | atom) slots; 0 marks an empty slot.
+  struct table
+  {
+    explicit table(std::size_t count)
+      : slots(count)
+    {
+    }
+    std::vector<std::atomic<std::uint64_t>> slots;
+  };
+
+  /// Texts are kept in segments of doubling size so they never move.
+  static constexpr std::uint32_t first_segment = 64;
+  static constexpr std::size_t segment_count = 26;
+  /// Text is copied into blocks of this many bytes (or one per longer text).
+  static constexpr std::size_t block_size = 64 * 1024;
+
+  static std::uint32_t hash(std::string_view text)
+  {
+    std::uint32_t result = 2166136261u; // FNV-1a
+    for (char cc : text)
+    {
+      result = (result ^ static_cast<unsigned char>(cc)) * 16777619u;
+    }
+    return result;
+  }
+
+  atom probe(const table& where, std::uint32_t hashed, std::string_view text) const
+  {
+    const std::size_t mask = where.slots.size() - 1;
+    for (std::size_t ii = hashed & mask;; ii = (ii + 1) & mask)
+    {
+      const std::uint64_t slot = where.slots[ii].load(std::memory_order_acquire);
+      if (slot == 0)
+      {
+        return atom::none;
+      }
+      if (static_cast<std::uint32_t>(slot >> 32) == hashed)
+      {
+        const auto name = static_cast<std::uint32_t>(slot);
+        if (*this->entry(name, false) == text)
+        {
+          return static_cast<atom>(name);
+        }
+      }
+    }
+  }
+
+  /// Fill an empty slot of \a where (with m_mutex held).
+  static void place(table& where, std::uint32_t hashed, atom name)
+  {
+    const std::size_t mask = where.slots.size() - 1;
+    std::size_t ii = hashed & mask;
+    while (where.slots[ii].load(std::memory_order_relaxed) != 0)
+    {
+      ii = (ii + 1) & mask;
+    }
+    where.slots[ii].store(
+      (static_cast<std::uint64_t>(hashed) << 32) | static_cast<std::uint32_t>(name),
+      std::memory_order_release);
+  }
+
+  /// Publish a copy of \a current with twice as many slots (with m_mutex held).
+  table* grow(const table& current)
+  {
+    m_tables.emplace_back(new table(2 * current.slots.size()));
+    table* larger = m_tables.back().get();
+    for (const auto& slot : current.slots)
+    {
+      const std::uint64_t value = slot.load(std::memory_order_relaxed);
+      if (value != 0)
+      {
+        place(*larger, static_cast<std::uint32_t>(value >> 32), static_cast<atom>(static_cast<std::uint32_t>(value)));
+      }
+    }
+    m_table.store(larger, std::memory_order_release);
+    return larger;
+  }
+
+  /// Return the text entry of atom \a name, allocating its segment when \a create is true.
+  std::string_view* entry(std::uint32_t name, bool create) const
+  {
+    // Segment k holds first_segment << k entries.
+    const std::uint32_t index = name - 1;
+    std::size_t segment = 0;
+    std::uint32_t start = 0;
+    while (index - start >= (first_segment << segment))
+    {
+      start += first_segment << segment;
+      ++segment;
+    }
+    std::string_view* entries = m_segments[segment].load(std::memory_order_acquire);
+    if (!entries && create)
+    {
+      entries = new std::string_view[first_segment << segment];
+      m_segments[segment].store(entries, std::memory_order_release);
+    }
+    return entries + (index - start);
+  }
+
+  /// Copy \a text into a block (with m_mutex held).
+  std::string_view store(std::string_view text)
+  {
+    if (text.size() > m_available)
+    {
+      const std::size_t size = text.size() > block_size ? text.size() : block_size;
+      m_blocks.emplace_back(new char[size]);
+      m_cursor = m_blocks.back().get();
+      m_available = size;
+    }
+    std::memcpy(m_cursor, text.data(), text.size());
+    std::string_view copy(m_cursor, text.size());
+    m_cursor += text.size();
+    m_available -= text.size();
+    return copy;
+  }
+
+  mutable std::mutex m_mutex;
+  std::atomic<table*> m_table{ nullptr };
+  std::vector<std::unique_ptr<table>> m_tables; // Every table ever published (readers may still use old ones).
+  mutable std::atomic<std::string_view*> m_segments[segment_count] = {};
+  std::atomic<std::uint32_t> m_size{ 0 };
+  std::size_t m_bytes = 0;
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+  char* m_cursor = nullptr;
+  std::size_t m_available = 0;
+};
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_atom_h
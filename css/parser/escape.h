@@ -0,0 +1,118 @@
+#ifndef css_parser_escape_h
+#define css_parser_escape_h
+#include "css/token/scan.h"
+
+#include <string>
+#include <string_view>
+
+namespace css
+{
+namespace parser
+{
+
+/// Append the UTF-8 encoding of \a codepoint to \a out.
+inline void append_utf8(std::string& out, char32_t codepoint)
+{
+  if (codepoint < 0x80)
+  {
+    out += static_cast<char>(codepoint);
+  }
+  else if (codepoint < 0x800)
+  {
+    out += static_cast<char>(0xc0 | (codepoint >> 6));
+    out += static_cast<char>(0x80 | (codepoint & 0x3f));
+  }
+  else if (codepoint < 0x10000)
+  {
+    out += static_cast<char>(0xe0 | (codepoint >> 12));
+    out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (codepoint & 0x3f));
+  }
+  else
+  {
+    out += static_cast<char>(0xf0 | (codepoint >> 18));
+    out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (codepoint & 0x3f));
+  }
+}
+
+/// Return true when \a text contains escape sequences (see token::escape).
+inline bool has_escapes(std::string_view text)
+{
+  return text.find('\\') != std::string_view::npos;
+}
+
+/// Decode the escape sequences (see token::escape) in \a text.
+///
+/// Hexadecimal escapes (and the whitespace character that may end
+/// them) are replaced by the code-point they name (or U+FFFD when it
+/// is zero, a surrogate, or out of range); any other escaped
+/// character is replaced by itself. As in token::escape, a backslash
+/// followed by seven or more hex digits only escapes the first.
+inline std::string unescape(std::string_view text)
+{
+  std::string result;
+  result.reserve(text.size());
+  for (std::size_t ii = 0; ii < text.size(); ++ii)
+  {
+    if (text[ii] != '\\' || ii + 1 == text.size())
+    {
+      result += text[ii];
+      continue;
+    }
+    char32_t codepoint = 0;
+    std::size_t digits = 0;
+    for (; digits < 6 && ii + 1 + digits < text.size(); ++digits)
+    {
+      char cc = text[ii + 1 + digits];
+      if (cc >= '0' && cc <= '9')
+      {
+        codepoint = (codepoint << 4) | static_cast<char32_t>(cc - '0');
+      }
+      else if (cc >= 'a' && cc <= 'f')
+      {
+        codepoint = (codepoint << 4) | static_cast<char32_t>(cc - 'a' + 10);
+      }
+      else if (cc >= 'A' && cc <= 'F')
+      {
+        codepoint = (codepoint << 4) | static_cast<char32_t>(cc - 'A' + 10);
+      }
+      else
+      {
+        break;
+      }
+    }
+    if (digits == 6 && ii + 7 < text.size() && scan::is_hex_digit(static_cast<unsigned char>(text[ii + 7])))
+    {
+      digits = 0;
+    }
+    if (digits == 0)
+    {
+      // The escaped character stands for itself.
+      result += text[++ii];
+      continue;
+    }
+    if (codepoint == 0 || (codepoint >= 0xd800 && codepoint <= 0xdfff) || codepoint > 0x10ffff)
+    {
+      codepoint = 0xfffd;
+    }
+    append_utf8(result, codepoint);
+    ii += digits;
+    if (ii + 1 < text.size() && text[ii + 1] == '\r' && ii + 2 < text.size() && text[ii + 2] == '\n')
+    {
+      ii += 2;
+    }
+    else if (ii + 1 < text.size() &&
+      (text[ii + 1] == ' ' || text[ii + 1] == '\t' || text[ii + 1] == '\n' || text[ii + 1] == '\r' || text[ii + 1] == '\f'))
+    {
+      ++ii;
+    }
+  }
+  return result;
+}
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_escape_h
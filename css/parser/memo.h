@@ -0,0 +1,177 @@
+#ifndef css_parser_memo_h
+#define css_parser_memo_h
+#include "css/composite/grammar.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional> // for hash
+#include <type_traits>
+#include <unordered_map>
+
+namespace css
+{
+namespace parser
+{
+
+/// Specialize this to derive from std::true_type for rules whose
+/// results css::parser::memoize should remember.
+///
+/// A memoized rule that matched before is skipped over without
+/// running its actions again, so only select rules whose actions (if
+/// any) need not run more than once per position. By default, the
+/// media-query rules that composite::media_condition and
+/// composite::mf_range re-parse after backtracking are memoized.
+template<typename Rule>
+struct memoized : std::false_type
+{
+};
+
+template<> struct memoized<composite::media_condition> : std::true_type {};
+template<> struct memoized<composite::media_in_parens> : std::true_type {};
+template<> struct memoized<composite::media_not> : std::true_type {};
+template<> struct memoized<composite::mf_name> : std::true_type {};
+template<> struct memoized<composite::mf_value> : std::true_type {};
+
+/// Specialize this to derive from std::true_type for rules that
+/// begin a new memoization scope: entering one forgets every result
+/// remembered so far.
+///
+/// Results are keyed by their position in the input buffer, so a
+/// scope must not span input that is discarded (e.g., by a streaming
+/// input) and later replaced by other text at the same address.
+template<typename Rule>
+struct memo_scope : std::false_type
+{
+};
+
+template<> struct memo_scope<composite::media_list> : std::true_type {};
+
+/// The results remembered by css::parser::memoize on one thread.
+class memo_table
+{
+public:
+  /// The table used by the calling thread.
+  static memo_table& local()
+  {
+    static thread_local memo_table table;
+    return table;
+  }
+
+  /// Return the result of \a rule at \a at: the end of its match, nullptr
+  /// when it failed, or \a at itself when it has not been remembered.
+  const char* find(const void* rule, const char* at)
+  {
+    ++m_lookups;
+    auto it = m_results.find(key{ rule, at });
+    if (it == m_results.end())
+    {
+      return at;
+    }
+    ++m_hits;
+    m_skipped += it->second ? static_cast<std::size_t>(it->second - at) : 0;
+    return it->second;
+  }
+
+  /// Remember the result of \a rule at \a at (see find()).
+  void store(const void* rule, const char* at, const char* end)
+  {
+    m_results[key{ rule, at }] = end;
+  }
+
+  /// Forget every result (but keep the statistics).
+  void clear()
+  {
+    m_results.clear();
+  }
+
+  /// The number of times a memoized rule was about to be matched.
+  std::size_t lookups() const { return m_lookups; }
+  /// The number of matches (re-parses) that were avoided.
+  std::size_t hits() const { return m_hits; }
+  /// The number of bytes that successful remembered matches skipped over.
+  std::size_t skipped() const { return m_skipped; }
+
+protected:
+  struct key
+  {
+    const void* rule;
+    const char* at;
+
+    bool operator == (const key& other) const
+    {
+      return this->rule == other.rule && this->at == other.at;
+    }
+  };
+
+  struct key_hash
+  {
+    std::size_t operator()(const key& kk) const
+    {
+      return std::hash<const void*>()(kk.rule) * 31 + std::hash<const void*>()(kk.at);
+    }
+  };
+
+  std::unordered_map<key, const char*, key_hash> m_results;
+  std::size_t m_lookups = 0;
+  std::size_t m_hits = 0;
+  std::size_t m_skipped = 0;
+};
+
+/// A control class that remembers where memoized rules matched.
+///
+/// Pass it as the control of `rule::parse` to avoid re-parsing the
+/// rules selected by css::parser::memoized (packrat parsing). Other
+/// rules behave as they do with `rule::normal`. Results are kept in
+/// memo_table::local() and forgotten whenever a memo_scope rule is
+/// entered.
+template<typename Rule>
+struct memoize : rule::normal<Rule>
+{
+  /// The address of this identifies Rule in the memo_table.
+  static constexpr char tag = 0;
+
+  template<
+    rule::apply_mode A,
+    rule::rewind_mode M,
+    template<typename...> class Action,
+    template<typename...> class Control,
+    typename Input,
+    typename... States>
+  static bool match(Input& in, States&&... st)
+  {
+    if constexpr (memo_scope<Rule>::value)
+    {
+      memo_table::local().clear();
+    }
+    if constexpr (!memoized<Rule>::value)
+    {
+      return rule::normal<Rule>::template match<A, M, Action, Control>(in, st...);
+    }
+    else
+    {
+      memo_table& memo = memo_table::local();
+      const char* at = in.current();
+      const char* end = memo.find(&tag, at);
+      if (end != at)
+      {
+        if (end)
+        {
+          in.bump(static_cast<std::size_t>(end - at));
+        }
+        return end != nullptr;
+      }
+      const bool matched = rule::normal<Rule>::template match<A, M, Action, Control>(in, st...);
+      // An empty match would look like a result that was never stored, so it is not stored.
+      if (!matched || in.current() != at)
+      {
+        memo.store(&tag, at, matched ? in.current() : nullptr);
+      }
+      return matched;
+    }
+  }
+};
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_memo_h
@@ -0,0 +1,103 @@
+#ifndef css_parser_number_h
+#define css_parser_number_h
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <system_error>
+
+namespace css
+{
+namespace parser
+{
+
+/// Convert the text of a token::number in [\a begin, \a end) to a double.
+///
+/// The conversion does not depend on the current locale. The text must
+/// have the form the grammar accepts: an optional sign, digits with an
+/// optional fraction (or a fraction alone), and an optional exponent.
+///
+/// Numbers with at most 19 significant digits whose value is exactly
+/// representable (below 2^53) and whose decimal exponent is at most 22
+/// in magnitude (nearly every number in a stylesheet) are converted
+/// with a single multiplication or division by an exact power of ten,
+/// which is correctly rounded. Others are passed to std::from_chars,
+/// which is also correctly rounded.
+inline double to_number(const char* begin, const char* end)
+{
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* cc = begin;
+  bool negative = false;
+  if (cc != end && (*cc == '+' || *cc == '-'))
+  {
+    negative = *cc == '-';
+    ++cc;
+  }
+  const char* mantissa = cc;
+  std::uint64_t digits = 0;
+  int significant = 0;
+  int exponent = 0;
+  for (; cc != end && *cc >= '0' && *cc <= '9'; ++cc)
+  {
+    if (digits != 0 || *cc != '0')
+    {
+      digits = digits * 10 + static_cast<std::uint64_t>(*cc - '0');
+      ++significant;
+    }
+  }
+  if (cc != end && *cc == '.')
+  {
+    for (++cc; cc != end && *cc >= '0' && *cc <= '9'; ++cc)
+    {
+      if (digits != 0 || *cc != '0')
+      {
+        digits = digits * 10 + static_cast<std::uint64_t>(*cc - '0');
+        ++significant;
+      }
+      --exponent;
+    }
+  }
+  if (cc != end && (*cc == 'e' || *cc == 'E'))
+  {
+    ++cc;
+    bool negative_exponent = false;
+    if (cc != end && (*cc == '+' || *cc == '-'))
+    {
+      negative_exponent = *cc == '-';
+      ++cc;
+    }
+    int value = 0;
+    for (; cc != end && *cc >= '0' && *cc <= '9'; ++cc)
+    {
+      // Saturate; anything this large is out of range for the fast path.
+      if (value < 100000)
+      {
+        value = value * 10 + (*cc - '0');
+      }
+    }
+    exponent += negative_exponent ? -value : value;
+  }
+  if (significant <= 19 && digits <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+  {
+    double result = static_cast<double>(digits);
+    result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+    return negative ? -result : result;
+  }
+  // std::from_chars rejects a leading '+' but accepts everything else the grammar does.
+  double result = 0.0;
+  if (std::from_chars(mantissa, end, result).ec == std::errc::result_out_of_range)
+  {
+    // Overflow saturates to infinity; underflow to zero. The number of
+    // digits before the decimal point (significant + exponent) tells which.
+    result = significant + exponent > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+  }
+  return negative ? -result : result;
+}
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_number_h
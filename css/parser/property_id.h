@@ -0,0 +1,323 @@
+#ifndef css_parser_property_id_h
+#define css_parser_property_id_h
+#include "css/token/keyword.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace css
+{
+namespace parser
+{
+
+/// Properties known to the parser (those of CSS 2.1 and common later
+/// ones), in alphabetical order.
+///
+/// Each parsed property records its ID (see basic_property::id), so
+/// that known properties are found and compared without hashing or
+/// comparing their names. Any other property (including custom
+/// properties) is property_id::unknown and is identified by its name.
+enum class property_id : std::uint8_t
+{
+  unknown,
+  align_content,
+  align_items,
+  align_self,
+  animation,
+  animation_delay,
+  animation_direction,
+  animation_duration,
+  animation_fill_mode,
+  animation_iteration_count,
+  animation_name,
+  animation_play_state,
+  animation_timing_function,
+  azimuth,
+  background,
+  background_attachment,
+  background_clip,
+  background_color,
+  background_image,
+  background_origin,
+  background_position,
+  background_repeat,
+  background_size,
+  border,
+  border_bottom,
+  border_bottom_color,
+  border_bottom_left_radius,
+  border_bottom_right_radius,
+  border_bottom_style,
+  border_bottom_width,
+  border_collapse,
+  border_color,
+  border_left,
+  border_left_color,
+  border_left_style,
+  border_left_width,
+  border_radius,
+  border_right,
+  border_right_color,
+  border_right_style,
+  border_right_width,
+  border_spacing,
+  border_style,
+  border_top,
+  border_top_color,
+  border_top_left_radius,
+  border_top_right_radius,
+  border_top_style,
+  border_top_width,
+  border_width,
+  bottom,
+  box_shadow,
+  box_sizing,
+  caption_side,
+  clear,
+  clip,
+  color,
+  column_gap,
+  content,
+  counter_increment,
+  counter_reset,
+  cue,
+  cue_after,
+  cue_before,
+  cursor,
+  direction,
+  display,
+  elevation,
+  empty_cells,
+  flex,
+  flex_basis,
+  flex_direction,
+  flex_flow,
+  flex_grow,
+  flex_shrink,
+  flex_wrap,
+  float_,
+  font,
+  font_family,
+  font_size,
+  font_style,
+  font_variant,
+  font_weight,
+  gap,
+  height,
+  justify_content,
+  left,
+  letter_spacing,
+  line_height,
+  list_style,
+  list_style_image,
+  list_style_position,
+  list_style_type,
+  margin,
+  margin_bottom,
+  margin_left,
+  margin_right,
+  margin_top,
+  max_height,
+  max_width,
+  min_height,
+  min_width,
+  opacity,
+  order,
+  orphans,
+  outline,
+  outline_color,
+  outline_style,
+  outline_width,
+  overflow,
+  overflow_wrap,
+  overflow_x,
+  overflow_y,
+  padding,
+  padding_bottom,
+  padding_left,
+  padding_right,
+  padding_top,
+  page_break_after,
+  page_break_before,
+  page_break_inside,
+  pause,
+  pause_after,
+  pause_before,
+  pitch,
+  pitch_range,
+  play_during,
+  pointer_events,
+  position,
+  quotes,
+  richness,
+  right,
+  row_gap,
+  speak,
+  speak_header,
+  speak_numeral,
+  speak_punctuation,
+  speech_rate,
+  stress,
+  table_layout,
+  text_align,
+  text_decoration,
+  text_indent,
+  text_overflow,
+  text_shadow,
+  text_transform,
+  top,
+  transform,
+  transform_origin,
+  transition,
+  transition_delay,
+  transition_duration,
+  transition_property,
+  transition_timing_function,
+  unicode_bidi,
+  vertical_align,
+  visibility,
+  voice_family,
+  volume,
+  white_space,
+  widows,
+  width,
+  word_spacing,
+  word_wrap,
+  z_index
+};
+
+} // namespace parser
+
+namespace token
+{
+
+template<>
+struct keyword_names<parser::property_id>
+{
+  static constexpr std::string_view names[] = {
+    "", "align-content", "align-items", "align-self", "animation",
+    "animation-delay", "animation-direction", "animation-duration",
+    "animation-fill-mode", "animation-iteration-count", "animation-name",
+    "animation-play-state", "animation-timing-function", "azimuth",
+    "background", "background-attachment", "background-clip",
+    "background-color", "background-image", "background-origin",
+    "background-position", "background-repeat", "background-size", "border",
+    "border-bottom", "border-bottom-color", "border-bottom-left-radius",
+    "border-bottom-right-radius", "border-bottom-style",
+    "border-bottom-width", "border-collapse", "border-color", "border-left",
+    "border-left-color", "border-left-style", "border-left-width",
+    "border-radius", "border-right", "border-right-color",
+    "border-right-style", "border-right-width", "border-spacing",
+    "border-style", "border-top", "border-top-color",
+    "border-top-left-radius", "border-top-right-radius", "border-top-style",
+    "border-top-width", "border-width", "bottom", "box-shadow", "box-sizing",
+    "caption-side", "clear", "clip", "color", "column-gap", "content",
+    "counter-increment", "counter-reset", "cue", "cue-after", "cue-before",
+    "cursor", "direction", "display", "elevation", "empty-cells", "flex",
+    "flex-basis", "flex-direction", "flex-flow", "flex-grow", "flex-shrink",
+    "flex-wrap", "float", "font", "font-family", "font-size", "font-style",
+    "font-variant", "font-weight", "gap", "height", "justify-content",
+    "left", "letter-spacing", "line-height", "list-style",
+    "list-style-image", "list-style-position", "list-style-type", "margin",
+    "margin-bottom", "margin-left", "margin-right", "margin-top",
+    "max-height", "max-width", "min-height", "min-width", "opacity", "order",
+    "orphans", "outline", "outline-color", "outline-style", "outline-width",
+    "overflow", "overflow-wrap", "overflow-x", "overflow-y", "padding",
+    "padding-bottom", "padding-left", "padding-right", "padding-top",
+    "page-break-after", "page-break-before", "page-break-inside", "pause",
+    "pause-after", "pause-before", "pitch", "pitch-range", "play-during",
+    "pointer-events", "position", "quotes", "richness", "right", "row-gap",
+    "speak", "speak-header", "speak-numeral", "speak-punctuation",
+    "speech-rate", "stress", "table-layout", "text-align", "text-decoration",
+    "text-indent", "text-overflow", "text-shadow", "text-transform", "top",
+    "transform", "transform-origin", "transition", "transition-delay",
+    "transition-duration", "transition-property",
+    "transition-timing-function", "unicode-bidi", "vertical-align",
+    "visibility", "voice-family", "volume", "white-space", "widows", "width",
+    "word-spacing", "word-wrap", "z-index"
+  };
+};
+
+} // namespace token
+
+namespace parser
+{
+
+static_assert(token::keyword_table<property_id>::count == static_cast<std::size_t>(property_id::z_index) + 1,
+  "keyword_names<property_id> must name every property");
+
+/// Return the ID of the property named \a name (ignoring ASCII case) or property_id::unknown.
+inline property_id property_from_name(std::string_view name)
+{
+  return token::keyword_table<property_id>::lookup(name).value_or(property_id::unknown);
+}
+
+/// The lower-case name of \a id (empty for property_id::unknown).
+inline std::string_view property_name(property_id id)
+{
+  return token::keyword_table<property_id>::names[static_cast<std::size_t>(id)];
+}
+
+/// The longhands set by a shorthand property.
+struct shorthand
+{
+  property_id longhands[4]; //!< The longhands, in the order their terms are listed.
+  std::size_t count = 0;    //!< The number of longhands (0 when the property is not a shorthand).
+};
+
+/// Return the longhands of \a id when it is a shorthand whose value
+/// lists one term per longhand and may omit trailing terms.
+///
+/// Box shorthands (e.g., `margin`) list their top, right, bottom and
+/// left sides (or corners, starting at the top left); pairs (e.g.,
+/// `gap`) list their first longhand, then their second. Other
+/// shorthands, such as `font` or `border`, are not expanded.
+inline shorthand shorthand_longhands(property_id id)
+{
+  using p = property_id;
+  switch (id)
+  {
+  case p::margin:
+    return shorthand{ { p::margin_top, p::margin_right, p::margin_bottom, p::margin_left }, 4 };
+  case p::padding:
+    return shorthand{ { p::padding_top, p::padding_right, p::padding_bottom, p::padding_left }, 4 };
+  case p::border_width:
+    return shorthand{ { p::border_top_width, p::border_right_width, p::border_bottom_width, p::border_left_width }, 4 };
+  case p::border_style:
+    return shorthand{ { p::border_top_style, p::border_right_style, p::border_bottom_style, p::border_left_style }, 4 };
+  case p::border_color:
+    return shorthand{ { p::border_top_color, p::border_right_color, p::border_bottom_color, p::border_left_color }, 4 };
+  case p::border_radius:
+    return shorthand{ {
+      p::border_top_left_radius, p::border_top_right_radius,
+      p::border_bottom_right_radius, p::border_bottom_left_radius }, 4 };
+  case p::gap:
+    return shorthand{ { p::row_gap, p::column_gap }, 2 };
+  case p::overflow:
+    return shorthand{ { p::overflow_x, p::overflow_y }, 2 };
+  default:
+    return shorthand{};
+  }
+}
+
+/// Return which of \a terms terms sets longhand \a index of a
+/// shorthand with \a longhands longhands (see shorthand_longhands()).
+///
+/// A box (four longhands) repeats its top for a missing bottom and its
+/// right for a missing left; a pair repeats its first term.
+inline std::size_t shorthand_term(std::size_t longhands, std::size_t terms, std::size_t index)
+{
+  static const std::uint8_t box[4][4] = {
+    { 0, 0, 0, 0 },
+    { 0, 1, 0, 1 },
+    { 0, 1, 2, 1 },
+    { 0, 1, 2, 3 }
+  };
+  return longhands == 4 ? box[terms - 1][index] : (index < terms ? index : terms - 1);
+}
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_property_id_h
@@ -0,0 +1,231 @@
+#ifndef css_parser_specificity_h
+#define css_parser_specificity_h
+#include "css/parser/value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace css
+{
+namespace parser
+{
+
+/// Pack the counts of a selector's IDs, classes and types into one specificity.
+///
+/// Each count occupies 8 bits (and saturates at 255) so that packed
+/// specificities compare as plain integers: IDs outweigh any number of
+/// classes (which include attributes and pseudo-classes), which
+/// outweigh any number of types (which include pseudo-elements).
+inline std::uint32_t make_specificity(std::uint32_t ids, std::uint32_t classes, std::uint32_t types)
+{
+  auto cap = [](std::uint32_t count) { return count < 0xff ? count : 0xff; };
+  return (cap(ids) << 16) | (cap(classes) << 8) | cap(types);
+}
+
+/// Add the specificities \a aa and \a bb count by count.
+inline std::uint32_t add_specificity(std::uint32_t aa, std::uint32_t bb)
+{
+  return make_specificity(
+    (aa >> 16) + (bb >> 16),
+    ((aa >> 8) & 0xff) + ((bb >> 8) & 0xff),
+    (aa & 0xff) + (bb & 0xff));
+}
+
+/// Return the specificity (see make_specificity()) of a selector matched by composite::selector.
+///
+/// The \a text has already been checked by the grammar, so it is only
+/// scanned for the characters that begin each simple selector. The
+/// arguments of `:not()`, `:is()` and `:matches()` count as their most
+/// specific selector; those of `:where()` do not count; other
+/// functional pseudo-classes count as one class.
+inline std::uint32_t selector_specificity(std::string_view text)
+{
+  auto identifier = [](unsigned char cc)
+  {
+    return (cc >= 'a' && cc <= 'z') || (cc >= 'A' && cc <= 'Z') || (cc >= '0' && cc <= '9') ||
+      cc == '-' || cc == '_' || cc >= 0x80;
+  };
+  auto hex = [](char cc)
+  {
+    return (cc >= '0' && cc <= '9') || (cc >= 'a' && cc <= 'f') || (cc >= 'A' && cc <= 'F');
+  };
+  // Return where the identifier (or name) starting at ii ends.
+  auto skip_identifier = [&](std::size_t ii)
+  {
+    while (ii < text.size())
+    {
+      if (text[ii] == '\\')
+      {
+        // A hex escape is up to 6 digits and may end with one whitespace
+        // character (`\r\n` counts as one), which is part of the name.
+        const std::size_t digits = ++ii;
+        while (ii < text.size() && ii - digits < 6 && hex(text[ii]))
+        {
+          ++ii;
+        }
+        if (ii == digits)
+        {
+          ++ii;
+        }
+        else if (ii < text.size() && text[ii] == '\r' && ii + 1 < text.size() && text[ii + 1] == '\n')
+        {
+          ii += 2;
+        }
+        else if (ii < text.size() &&
+          (text[ii] == ' ' || text[ii] == '\t' || text[ii] == '\n' || text[ii] == '\r' || text[ii] == '\f'))
+        {
+          ++ii;
+        }
+      }
+      else if (identifier(static_cast<unsigned char>(text[ii])))
+      {
+        ++ii;
+      }
+      else
+      {
+        break;
+      }
+    }
+    return ii < text.size() ? ii : text.size();
+  };
+  // Return where the bracketed text opened at ii ends (after its closing bracket).
+  auto skip_nested = [&](std::size_t ii)
+  {
+    int depth = 0;
+    char quote = 0;
+    for (; ii < text.size(); ++ii)
+    {
+      const char cc = text[ii];
+      if (cc == '\\')
+      {
+        ++ii;
+      }
+      else if (quote)
+      {
+        quote = cc == quote ? 0 : quote;
+      }
+      else if (cc == '"' || cc == '\'')
+      {
+        quote = cc;
+      }
+      else if (cc == '[' || cc == '(')
+      {
+        ++depth;
+      }
+      else if ((cc == ']' || cc == ')') && --depth == 0)
+      {
+        return ii + 1;
+      }
+    }
+    return text.size();
+  };
+  // Return where the first comma at or after ii in \a list that is not
+  // inside brackets or a string is (the size of \a list when none is).
+  auto find_comma = [](std::string_view list, std::size_t ii)
+  {
+    int depth = 0;
+    char quote = 0;
+    for (; ii < list.size(); ++ii)
+    {
+      const char cc = list[ii];
+      if (cc == '\\')
+      {
+        ++ii;
+      }
+      else if (quote)
+      {
+        quote = cc == quote ? 0 : quote;
+      }
+      else if (cc == '"' || cc == '\'')
+      {
+        quote = cc;
+      }
+      else if (cc == '[' || cc == '(')
+      {
+        ++depth;
+      }
+      else if (cc == ']' || cc == ')')
+      {
+        --depth;
+      }
+      else if (cc == ',' && depth == 0)
+      {
+        return ii;
+      }
+    }
+    return list.size();
+  };
+
+  std::uint32_t result = 0;
+  for (std::size_t ii = 0; ii < text.size();)
+  {
+    const char cc = text[ii];
+    if (cc == '#')
+    {
+      result = add_specificity(result, make_specificity(1, 0, 0));
+      ii = skip_identifier(ii + 1);
+    }
+    else if (cc == '.')
+    {
+      result = add_specificity(result, make_specificity(0, 1, 0));
+      ii = skip_identifier(ii + 1);
+    }
+    else if (cc == '[')
+    {
+      result = add_specificity(result, make_specificity(0, 1, 0));
+      ii = skip_nested(ii);
+    }
+    else if (cc == ':')
+    {
+      const bool element = ii + 1 < text.size() && text[ii + 1] == ':';
+      const std::size_t begin = ii + (element ? 2 : 1);
+      const std::size_t end = skip_identifier(begin);
+      const std::string_view name = text.substr(begin, end - begin);
+      ii = end;
+      if (end < text.size() && text[end] == '(')
+      {
+        ii = skip_nested(end);
+        if (equal_ignoring_case(name, "not") || equal_ignoring_case(name, "is") || equal_ignoring_case(name, "matches"))
+        {
+          // Count the most specific selector in the argument list.
+          const std::string_view arguments = text.substr(end + 1, ii - end - 2);
+          std::uint32_t highest = 0;
+          for (std::size_t first = 0; first <= arguments.size();)
+          {
+            const std::size_t comma = find_comma(arguments, first);
+            const std::uint32_t each = selector_specificity(arguments.substr(first, comma - first));
+            highest = each > highest ? each : highest;
+            first = comma + 1;
+          }
+          result = add_specificity(result, highest);
+          continue;
+        }
+        if (equal_ignoring_case(name, "where"))
+        {
+          continue;
+        }
+      }
+      const bool legacy = !element && (equal_ignoring_case(name, "before") || equal_ignoring_case(name, "after") ||
+        equal_ignoring_case(name, "first-line") || equal_ignoring_case(name, "first-letter"));
+      result = add_specificity(result, (element || legacy) ? make_specificity(0, 0, 1) : make_specificity(0, 1, 0));
+    }
+    else if (cc == '\\' || identifier(static_cast<unsigned char>(cc)))
+    {
+      // A type selector (digits cannot begin one, so this never splits a name).
+      result = add_specificity(result, make_specificity(0, 0, 1));
+      ii = skip_identifier(ii);
+    }
+    else
+    {
+      // Universal selectors, combinators and whitespace do not count.
+      ++ii;
+    }
+  }
+  return result;
+}
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_specificity_h
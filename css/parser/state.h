@@ -1,8 +1,25 @@
 #ifndef css_parser_state_h
 #define css_parser_state_h
 #include "css/composite/grammar.h"
+#include "css/parser/atom.h"
+#include "css/parser/escape.h"
+#include "css/parser/property_id.h"
+#include "css/parser/specificity.h"
+#include "css/parser/value.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <deque>
 #include <functional> // for hash
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace css
 {
@@ -20,30 +37,122 @@ enum class origin
 namespace parser
 {
 
+/// Return \a text as a \a String, allocated from \a resource when \a String is allocator-aware.
+template<typename String>
+String make_string(std::string_view text, std::pmr::memory_resource* resource)
+{
+  if constexpr (std::uses_allocator<String, std::pmr::polymorphic_allocator<char>>::value)
+  {
+    return String(text.data(), text.size(), resource);
+  }
+  else
+  {
+    (void)resource;
+    return String(text);
+  }
+}
+
+/// Move \a text into a \a String allocated from \a resource when \a String is allocator-aware.
+template<typename String>
+String move_string(String&& text, std::pmr::memory_resource* resource)
+{
+  if constexpr (std::uses_allocator<String, std::pmr::polymorphic_allocator<char>>::value)
+  {
+    return String(std::move(text), resource);
+  }
+  else
+  {
+    (void)resource;
+    return String(std::move(text));
+  }
+}
+
 /// A property name and value.
-struct property
+///
+/// The \a String type is either `std::string` (the property owns its
+/// text), `std::pmr::string` (the property owns its text but allocates
+/// it from a memory resource), or `std::string_view` (the property
+/// refers to the parser's input, which must be kept alive as long as
+/// the property is used).
+template<typename String>
+struct basic_property
 {
-  std::string name; //!< The property's name (an identifier)
-  mutable std::string value; //!< The property's value (NB: This will become a variant in the future).
+  /// Properties are allocator-aware so that containers of them can
+  /// pass their memory resource on to `std::pmr::string` members.
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  basic_property() = default;
+  basic_property(const basic_property&) = default;
+  basic_property(basic_property&&) = default;
+  basic_property& operator = (const basic_property&) = default;
+  basic_property& operator = (basic_property&&) = default;
+
+  explicit basic_property(const allocator_type& alloc)
+    : name(make_string<String>(std::string_view(), alloc.resource()))
+    , value(make_string<String>(std::string_view(), alloc.resource()))
+    , typed(alloc.resource())
+  {
+  }
+  basic_property(const basic_property& other, const allocator_type& alloc)
+    : name(make_string<String>(std::string_view(other.name), alloc.resource()))
+    , id(other.id)
+    , value(make_string<String>(std::string_view(other.value), alloc.resource()))
+    , typed(other.typed, alloc.resource())
+    , source(other.source)
+    , important(other.important)
+    , order(other.order)
+  {
+  }
+  basic_property(basic_property&& other, const allocator_type& alloc)
+    : name(move_string<String>(std::move(other.name), alloc.resource()))
+    , id(other.id)
+    , value(move_string<String>(std::move(other.value), alloc.resource()))
+    , typed(std::move(other.typed), alloc.resource())
+    , source(other.source)
+    , important(other.important)
+    , order(other.order)
+  {
+  }
+
+  String name; //!< The property's name (an identifier)
+  property_id id = property_id::unknown; //!< The property named by \a name (if it is known).
+  mutable String value; //!< The property's value as text.
+  mutable compact_value typed; //!< The terms of the value in compact binary form, referring to \a value.
   mutable origin source = origin::user_agent; //!< What type of stylesheet or animation is providing the value.
   mutable bool important = false; //!< Whether the property has been prioritized as important.
+  std::uint32_t order = 0; //!< The declaration's position among its stylesheet's declarations (its source order).
 
   /// Initialize the property to its default state.
   void clear()
   {
-    this->name.clear();
+    this->name = String();
+    this->id = property_id::unknown;
+    this->typed.clear();
     this->source = origin::user_agent;
     this->important = false;
+    this->order = 0;
   }
   /// Returns true when the name is set; false otherwise.
-  bool is_set()
+  bool is_set() const
   {
     return !name.empty();
   }
 };
 
+/// A property that owns its name and value.
+using property = basic_property<std::string>;
+/// A property whose name and value refer to the parser's input.
+using property_view = basic_property<std::string_view>;
+
+namespace pmr
+{
+/// A property that allocates its name and value from a memory resource.
+using property = basic_property<std::pmr::string>;
+}
+
 /// Print property information.
-inline std::ostream& operator << (std::ostream& os, const property& p)
+template<typename String>
+std::ostream& operator << (std::ostream& os, const basic_property<String>& p)
 {
   os << p.name << ": " << p.value;
   if (p.important)
@@ -53,59 +162,1078 @@ inline std::ostream& operator << (std::ostream& os, const property& p)
   return os;
 }
 
-/// A set of properties stored by hashing their names.
-class property_data
+/// Returns true when \a name is a custom property (i.e., begins with "--").
+inline bool is_custom_property(std::string_view name)
+{
+  return name.size() >= 2 && name[0] == '-' && name[1] == '-';
+}
+
+/// Hash a property name, ignoring ASCII case.
+///
+/// Property names are ASCII case-insensitive except for custom
+/// properties, whose names are hashed exactly.
+inline std::uint32_t property_name_hash(std::string_view name)
+{
+  const bool fold = !is_custom_property(name);
+  std::uint32_t hash = 2166136261u; // FNV-1a
+  for (char cc : name)
+  {
+    auto byte = static_cast<unsigned char>(cc);
+    if (fold && byte >= 'A' && byte <= 'Z')
+    {
+      byte |= 0x20;
+    }
+    hash = (hash ^ byte) * 16777619u;
+  }
+  return hash;
+}
+
+/// Hash the key of a property with ID \a id and name \a name.
+///
+/// Known properties hash their ID, so only unknown ones hash their
+/// name (see property_name_hash()).
+inline std::uint32_t property_key_hash(property_id id, std::string_view name)
+{
+  return id != property_id::unknown ?
+    (static_cast<std::uint32_t>(id) + 1) * 0x9e3779b1u : property_name_hash(name);
+}
+
+/// Compare property names, ignoring ASCII case (except for custom properties).
+inline bool property_name_equal(std::string_view aa, std::string_view bb)
+{
+  if (aa.size() != bb.size())
+  {
+    return false;
+  }
+  if (is_custom_property(aa))
+  {
+    return aa == bb;
+  }
+  for (std::size_t ii = 0; ii < aa.size(); ++ii)
+  {
+    auto ca = static_cast<unsigned char>(aa[ii]);
+    auto cb = static_cast<unsigned char>(bb[ii]);
+    if (ca != cb && ((ca | 0x20) != (cb | 0x20) || (ca | 0x20) < 'a' || (ca | 0x20) > 'z'))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// A set of properties keyed by (case-insensitive) name.
+///
+/// Properties are kept in insertion order (which is also the order of
+/// iteration); inserting a property whose name is already present
+/// replaces it in place, unless the present one is `!important` and
+/// the new one is not: an important declaration outranks any later
+/// normal one in the cascade, so that insertion is ignored. Up to
+/// \a InlineCapacity properties (enough for a typical declaration
+/// block) are stored inside the object and found by scanning their
+/// cached key hashes. Larger sets move to a contiguous array indexed
+/// by an open-addressing (linear probing) table. Known properties are
+/// keyed by their css::parser::property_id and compared as integers;
+/// the names of other properties are always compared in full, so
+/// distinct properties never collide.
+template<typename String, std::size_t InlineCapacity = 8>
+class basic_property_data
 {
 public:
-  std::size_t size() const { return m_data.size(); }
-  void insert(const property& p)
+  using property_type = basic_property<String>;
+  using allocator_type = std::pmr::polymorphic_allocator<property_type>;
+  static constexpr std::size_t inline_capacity = InlineCapacity;
+
+  basic_property_data()
+    : basic_property_data(allocator_type())
+  {
+  }
+  explicit basic_property_data(const allocator_type& alloc)
+    : m_entries(alloc)
+    , m_buckets(alloc)
+  {
+  }
+  basic_property_data(const basic_property_data& other)
+    : basic_property_data(other, allocator_type())
+  {
+  }
+  basic_property_data(const basic_property_data& other, const allocator_type& alloc)
+    : basic_property_data(alloc)
+  {
+    this->assign(other);
+  }
+  basic_property_data(basic_property_data&& other)
+    : basic_property_data(std::move(other), other.get_allocator())
+  {
+  }
+  basic_property_data(basic_property_data&& other, const allocator_type& alloc)
+    : basic_property_data(alloc)
+  {
+    this->take(std::move(other));
+  }
+  basic_property_data& operator = (const basic_property_data& other)
   {
-    std::size_t key = std::hash<std::string>{}(p.name);
-    m_data[key] = p;
+    if (this != &other)
+    {
+      this->clear();
+      this->assign(other);
+    }
+    return *this;
   }
-  const property* find(const std::string& name) const
+  basic_property_data& operator = (basic_property_data&& other)
   {
-    std::size_t key = std::hash<std::string>{}(name);
-    auto it = m_data.find(key);
-    if (it == m_data.end())
+    if (this != &other)
+    {
+      this->clear();
+      this->take(std::move(other));
+    }
+    return *this;
+  }
+  ~basic_property_data()
+  {
+    this->clear();
+  }
+
+  allocator_type get_allocator() const { return m_entries.get_allocator(); }
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  void insert(const property_type& p)
+  {
+    this->emplace(p);
+  }
+  void insert(property_type&& p)
+  {
+    this->emplace(std::move(p));
+  }
+  const property_type* find(std::string_view name) const
+  {
+    const property_id id = property_from_name(name);
+    std::size_t index = this->index_of(id, name, property_key_hash(id, name));
+    return index == npos ? nullptr : &this->at(index);
+  }
+  /// Find a known property without hashing or comparing its name.
+  const property_type* find(property_id id) const
+  {
+    if (id == property_id::unknown)
     {
       return nullptr;
     }
-    return &it->second;
+    std::size_t index = this->index_of(id, std::string_view(), property_key_hash(id, std::string_view()));
+    return index == npos ? nullptr : &this->at(index);
   }
-  void visit(std::function<void(const property&)> visitor) const
+  /// Invoke \a visitor on each property in insertion order.
+  template<typename Visitor>
+  void visit(Visitor&& visitor) const
   {
-    for (const auto& entry : m_data)
+    for (const auto& p : *this)
     {
-      visitor(entry.second);
+      visitor(p);
     }
   }
+
+  /// Properties are stored contiguously (inline or in an array), so
+  /// plain pointers serve as iterators.
+  using const_iterator = const property_type*;
+  const_iterator begin() const
+  {
+    return this->is_inline() ? this->inline_entry(0) : m_entries.data();
+  }
+  const_iterator end() const
+  {
+    return this->begin() + m_size;
+  }
   void clear()
   {
-    m_data.clear();
+    if (this->is_inline())
+    {
+      for (std::size_t ii = 0; ii < m_size; ++ii)
+      {
+        this->inline_entry(ii)->~property_type();
+      }
+    }
+    m_entries.clear();
+    m_buckets.clear();
+    m_size = 0;
   }
+
 protected:
-  std::map<std::size_t, property> m_data;
+  static constexpr std::size_t npos = ~std::size_t(0);
+
+  /// A slot in the open-addressing table.
+  struct bucket
+  {
+    std::uint32_t hash;  //!< The name hash of the entry.
+    std::uint32_t entry; //!< One more than the entry's index (0 for an empty slot).
+  };
+
+  /// Properties are stored inline until the table has been built.
+  bool is_inline() const { return m_buckets.empty(); }
+
+  property_type* inline_entry(std::size_t ii)
+  {
+    return std::launder(reinterpret_cast<property_type*>(m_inline) + ii);
+  }
+  const property_type* inline_entry(std::size_t ii) const
+  {
+    return std::launder(reinterpret_cast<const property_type*>(m_inline) + ii);
+  }
+  property_type& at(std::size_t ii)
+  {
+    return this->is_inline() ? *this->inline_entry(ii) : m_entries[ii];
+  }
+  const property_type& at(std::size_t ii) const
+  {
+    return this->is_inline() ? *this->inline_entry(ii) : m_entries[ii];
+  }
+
+  /// Returns true when \a entry has the key (\a id, \a name).
+  static bool same_key(const property_type& entry, property_id id, std::string_view name)
+  {
+    return entry.id == id && (id != property_id::unknown || property_name_equal(entry.name, name));
+  }
+
+  std::size_t index_of(property_id id, std::string_view name, std::uint32_t hash) const
+  {
+    if (this->is_inline())
+    {
+      for (std::size_t ii = 0; ii < m_size; ++ii)
+      {
+        if (m_hashes[ii] == hash && same_key(*this->inline_entry(ii), id, name))
+        {
+          return ii;
+        }
+      }
+      return npos;
+    }
+    const std::size_t mask = m_buckets.size() - 1;
+    for (std::size_t ii = hash & mask; m_buckets[ii].entry != 0; ii = (ii + 1) & mask)
+    {
+      const auto& slot = m_buckets[ii];
+      if (slot.hash == hash && same_key(m_entries[slot.entry - 1], id, name))
+      {
+        return slot.entry - 1;
+      }
+    }
+    return npos;
+  }
+
+  template<typename Property>
+  void emplace(Property&& p)
+  {
+    // Properties built by hand may not have looked up their ID.
+    const property_id id = p.id != property_id::unknown ? p.id : property_from_name(p.name);
+    std::uint32_t hash = property_key_hash(id, p.name);
+    std::size_t index = this->index_of(id, p.name, hash);
+    if (index != npos)
+    {
+      if (this->at(index).important && !p.important)
+      {
+        return;
+      }
+      this->at(index) = std::forward<Property>(p);
+      this->at(index).id = id;
+      return;
+    }
+    if (this->is_inline())
+    {
+      if (m_size < InlineCapacity)
+      {
+        new (this->inline_entry(m_size)) property_type(
+          std::forward<Property>(p),
+          typename property_type::allocator_type(this->get_allocator().resource()));
+        this->inline_entry(m_size)->id = id;
+        m_hashes[m_size++] = hash;
+        return;
+      }
+      this->spill();
+    }
+    m_entries.push_back(std::forward<Property>(p));
+    m_entries.back().id = id;
+    ++m_size;
+    if (2 * m_size > m_buckets.size())
+    {
+      this->rehash(2 * m_buckets.size());
+    }
+    else
+    {
+      this->place(hash, m_size - 1);
+    }
+  }
+
+  /// Move inline properties into the array and build the hash table.
+  void spill()
+  {
+    m_entries.reserve(2 * InlineCapacity);
+    for (std::size_t ii = 0; ii < m_size; ++ii)
+    {
+      m_entries.push_back(std::move(*this->inline_entry(ii)));
+      this->inline_entry(ii)->~property_type();
+    }
+    std::size_t count = 4;
+    while (count < 4 * InlineCapacity)
+    {
+      count *= 2;
+    }
+    m_buckets.assign(count, bucket{ 0, 0 });
+    for (std::size_t ii = 0; ii < m_size; ++ii)
+    {
+      this->place(m_hashes[ii], ii);
+    }
+  }
+
+  void rehash(std::size_t count)
+  {
+    std::pmr::vector<bucket> buckets(count, bucket{ 0, 0 }, m_buckets.get_allocator());
+    buckets.swap(m_buckets);
+    for (const auto& slot : buckets)
+    {
+      if (slot.entry != 0)
+      {
+        this->place(slot.hash, slot.entry - 1);
+      }
+    }
+    // The newest entry has not been placed yet.
+    this->place(property_key_hash(m_entries.back().id, m_entries.back().name), m_size - 1);
+  }
+
+  void place(std::uint32_t hash, std::size_t index)
+  {
+    const std::size_t mask = m_buckets.size() - 1;
+    std::size_t ii = hash & mask;
+    while (m_buckets[ii].entry != 0)
+    {
+      ii = (ii + 1) & mask;
+    }
+    m_buckets[ii] = bucket{ hash, static_cast<std::uint32_t>(index + 1) };
+  }
+
+  void assign(const basic_property_data& other)
+  {
+    for (std::size_t ii = 0; ii < other.m_size; ++ii)
+    {
+      this->emplace(other.at(ii));
+    }
+  }
+
+  void take(basic_property_data&& other)
+  {
+    if (other.is_inline() || other.get_allocator() != this->get_allocator())
+    {
+      for (std::size_t ii = 0; ii < other.m_size; ++ii)
+      {
+        this->emplace(std::move(other.at(ii)));
+      }
+    }
+    else
+    {
+      m_entries = std::move(other.m_entries);
+      m_buckets = std::move(other.m_buckets);
+      m_size = other.m_size;
+      other.m_size = 0;
+    }
+    other.clear();
+  }
+
+  std::size_t m_size = 0;
+  std::uint32_t m_hashes[InlineCapacity];
+  alignas(property_type) unsigned char m_inline[InlineCapacity * sizeof(property_type)];
+  std::pmr::vector<property_type> m_entries;
+  std::pmr::vector<bucket> m_buckets;
+};
+
+using property_data = basic_property_data<std::string>;
+using property_data_view = basic_property_data<std::string_view>;
+
+/// Counts of the identifiers a stylesheet has interned.
+///
+/// Comparing these with the size and bytes of the atom_table shows how
+/// much text interning saved compared to storing each identifier.
+struct atom_usage
+{
+  std::size_t references = 0; //!< The number of identifiers interned.
+  std::size_t bytes = 0;      //!< The total length of those identifiers.
+
+  atom_usage& operator += (const atom_usage& other)
+  {
+    this->references += other.references;
+    this->bytes += other.bytes;
+    return *this;
+  }
+};
+
+/// How a compound selector relates to the compound before it.
+enum class combinator : std::uint8_t
+{
+  none,       //!< The first compound of a selector.
+  descendant, //!< Whitespace: any ancestor matches the previous compound.
+  child,      //!< `>`: the parent matches the previous compound.
+  adjacent    //!< `+`: the previous sibling matches the previous compound.
 };
 
 /// Accumulate state as we parse tokens.
-struct accumulator
+template<typename String>
+struct basic_accumulator
 {
-  std::string selector;
-  property_data properties;
-  property prop;
+  /// A value component whose text is still located by pointers into the input.
+  struct pending_component
+  {
+    const char* begin;
+    const char* end;
+    parser::component item;
+  };
+
+  /// A compound selector (composite::simple_selector) in the input.
+  struct compound
+  {
+    const char* begin;
+    const char* end;
+    parser::combinator relation; //!< How the compound relates to the previous one.
+  };
+
+  /// A selector of the ruleset being parsed and where it begins in the input.
+  struct selector_entry
+  {
+    const char* begin;
+    String text;
+    std::uint32_t specificity; //!< See selector_specificity().
+  };
+
+  explicit basic_accumulator(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : selectors(resource)
+    , properties(resource)
+    , prop(resource)
+    , components(resource)
+    , compounds(resource)
+  {
+  }
+
+  /// The selectors of the ruleset being parsed (a comma-separated list), in input order.
+  std::pmr::vector<selector_entry> selectors;
+  basic_property_data<String> properties;
+  basic_property<String> prop;
+  /// The number of declarations parsed so far (and so the source order of the next one).
+  std::uint32_t declarations = 0;
+
+  /// Components of the property value being parsed, in input order.
+  std::pmr::vector<pending_component> components;
+  /// The value of the most recent token::number.
+  double number = 0.0;
+  /// The kind of the most recent numeric token's unit suffix and where that suffix begins.
+  token::numeric_kind suffix_kind = token::numeric_kind::number;
+  const char* suffix = nullptr;
+  /// The end of the most recent hash or function (excluding trailing whitespace).
+  const char* token_end = nullptr;
+
+  /// The table in which identifiers are interned.
+  atom_table* atoms = &atom_table::global();
+  /// The identifiers interned so far.
+  atom_usage interned;
+
+  /// The compounds of the selectors of the current ruleset, in input order.
+  ///
+  /// Each selector starts with a compound whose relation is
+  /// combinator::none; those before \a selected belong to selectors
+  /// that have been matched in full (see end_selector()). While
+  /// action<composite::ruleset> runs, between keep_ruleset() and
+  /// end_ruleset(), these are exactly the compounds of its selectors.
+  std::pmr::vector<compound> compounds;
+  std::size_t selected = 0;
+  /// The relation of the next compound to the previous one.
+  parser::combinator relation = parser::combinator::descendant;
+
+  /// Record the selector \a text that begins at \a begin.
+  void add_selector(const char* begin, String&& text)
+  {
+    // Selectors at or after begin were matched by alternatives that failed.
+    while (!this->selectors.empty() && this->selectors.back().begin >= begin)
+    {
+      this->selectors.pop_back();
+    }
+    const std::uint32_t specificity = selector_specificity(std::string_view(text));
+    this->selectors.push_back(selector_entry{ begin, std::move(text), specificity });
+  }
+
+  /// Record the compound selector from \a begin to \a end.
+  void add_compound(const char* begin, const char* end)
+  {
+    // Compounds at or after begin were matched by alternatives that failed.
+    while (this->compounds.size() > this->selected && this->compounds.back().begin >= begin)
+    {
+      this->compounds.pop_back();
+    }
+    this->compounds.push_back(compound{ begin, end, this->relation });
+    this->relation = parser::combinator::descendant;
+  }
+
+  /// Finish the selector that begins at \a begin, whose compounds are the last ones recorded.
+  void end_selector(const char* begin)
+  {
+    auto first = this->compounds.begin() + static_cast<std::ptrdiff_t>(this->selected);
+    first = this->compounds.erase(first, std::find_if(first, this->compounds.end(),
+      [begin](const compound& entry) { return entry.begin >= begin; }));
+    if (first != this->compounds.end())
+    {
+      first->relation = parser::combinator::none;
+    }
+    this->selected = this->compounds.size();
+    this->relation = parser::combinator::descendant;
+  }
+
+  /// Forget selectors and compounds recorded before \a begin, where the ruleset just matched begins.
+  void keep_ruleset(const char* begin)
+  {
+    this->selectors.erase(this->selectors.begin(), std::find_if(this->selectors.begin(), this->selectors.end(),
+      [begin](const selector_entry& entry) { return entry.begin >= begin; }));
+    auto first = std::find_if(this->compounds.begin(), this->compounds.end(),
+      [begin](const compound& entry) { return entry.begin >= begin; });
+    const auto dropped = static_cast<std::size_t>(first - this->compounds.begin());
+    this->selected = this->selected > dropped ? this->selected - dropped : 0;
+    this->compounds.erase(this->compounds.begin(), first);
+  }
+
+  /// Forget the selectors and compounds of the ruleset that has just been stored.
+  ///
+  /// Positions in a streaming input restart after each rule::discard,
+  /// so the pruning by position above cannot be relied on to drop them.
+  void end_ruleset()
+  {
+    this->selectors.clear();
+    this->compounds.clear();
+    this->selected = 0;
+    this->relation = parser::combinator::descendant;
+  }
+
+  /// Intern the identifier from \a begin to \a end (with any escapes decoded).
+  parser::atom intern(const char* begin, const char* end)
+  {
+    const std::string_view raw(begin, static_cast<std::size_t>(end - begin));
+    ++this->interned.references;
+    this->interned.bytes += raw.size();
+    return has_escapes(raw) ? this->atoms->intern(unescape(raw)) : this->atoms->intern(raw);
+  }
+
+  /// Record a value component spanning [\a begin, \a end).
+  ///
+  /// Components at or after \a begin were matched by alternatives that
+  /// failed later on or are nested inside this one (e.g., the arguments
+  /// of a function), so they are discarded.
+  void add_component(const char* begin, const char* end, const parser::component& item)
+  {
+    while (!this->components.empty() && this->components.back().begin >= begin)
+    {
+      this->components.pop_back();
+    }
+    this->components.push_back(pending_component{ begin, end, item });
+  }
+
+  /// Move the components inside the value [\a begin, \a end) into prop.typed.
+  void finish_value(const char* begin, const char* end)
+  {
+    this->prop.typed.clear();
+    for (const auto& entry : this->components)
+    {
+      if (entry.begin >= begin && entry.end <= end)
+      {
+        parser::component item = entry.item;
+        if (item.type == value_type::ident)
+        {
+          item.name = this->intern(entry.begin, entry.end);
+        }
+        item.offset = static_cast<std::uint32_t>(entry.begin - begin);
+        item.length = static_cast<std::uint32_t>(entry.end - entry.begin);
+        this->prop.typed.push_back(item);
+      }
+    }
+    this->components.clear();
+  }
+
+  /// Insert the longhands of prop into properties when it is a
+  /// shorthand whose terms each set one or more of its longhands
+  /// (see shorthand_longhands()).
+  ///
+  /// Returns false (leaving prop alone) when prop is not such a
+  /// shorthand or its value does not list between one term and one
+  /// term per longhand, separated only by whitespace. Values using
+  /// `var()` or `env()` are never expanded, since a single function may
+  /// stand for any number of terms.
+  bool expand_shorthand()
+  {
+    const shorthand longhands = shorthand_longhands(this->prop.id);
+    const compact_value& terms = this->prop.typed;
+    if (longhands.count == 0 || terms.empty() || terms.overflowed() || terms.size() > longhands.count)
+    {
+      return false;
+    }
+    const std::string_view text(this->prop.value);
+    std::size_t cursor = 0;
+    for (const auto& term : terms)
+    {
+      if (!blank(text.substr(cursor, term.offset - cursor)))
+      {
+        return false;
+      }
+      if (term.type == value_type::function)
+      {
+        const std::string_view call = term.text(text);
+        const std::string_view name = call.substr(0, call.find('('));
+        if (equal_ignoring_case(name, "var") || equal_ignoring_case(name, "env"))
+        {
+          return false;
+        }
+      }
+      cursor = term.offset + term.length;
+    }
+    if (!blank(text.substr(cursor)))
+    {
+      return false;
+    }
+    std::pmr::memory_resource* resource = this->properties.get_allocator().resource();
+    for (std::size_t ii = 0; ii < longhands.count; ++ii)
+    {
+      parser::component item = terms[shorthand_term(longhands.count, terms.size(), ii)];
+      basic_property<String> longhand(resource);
+      longhand.name = make_string<String>(property_name(longhands.longhands[ii]), resource);
+      longhand.id = longhands.longhands[ii];
+      longhand.value = make_string<String>(text.substr(item.offset, item.length), resource);
+      item.offset = 0;
+      longhand.typed.push_back(item);
+      longhand.source = this->prop.source;
+      longhand.important = this->prop.important;
+      longhand.order = this->prop.order;
+      this->properties.insert(std::move(longhand));
+    }
+    return true;
+  }
+
+  /// Returns true when \a text is empty or only whitespace.
+  static bool blank(std::string_view text)
+  {
+    for (char cc : text)
+    {
+      if (!scan::is_ascii_whitespace(static_cast<unsigned char>(cc)))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+using accumulator = basic_accumulator<std::string>;
+using accumulator_view = basic_accumulator<std::string_view>;
+
+namespace pmr
+{
+using property_data = basic_property_data<std::pmr::string>;
+using accumulator = basic_accumulator<std::pmr::string>;
+}
+
+/// The declarations that apply to one selector of a stylesheet.
+///
+/// Declaration blocks are immutable and shared: every selector of a
+/// comma-separated list refers to its ruleset's block, as does every
+/// other ruleset with the same declarations. Since a shared block was
+/// parsed at one place in the input, each rule adds \a shift to the
+/// order of its declarations to give their source order at the rule's
+/// own place (see source_order()).
+template<typename String>
+struct basic_rule
+{
+  using property_type = basic_property<String>;
+  using property_data_type = basic_property_data<String>;
+  using block_type = std::shared_ptr<const property_data_type>;
+  using const_iterator = typename property_data_type::const_iterator;
+
+  block_type block;
+  std::uint32_t specificity = 0; //!< The specificity of the rule's selector (see selector_specificity()).
+  std::uint32_t shift = 0; //!< Added (modulo 2^32) to the order of the block's declarations.
+
+  const property_data_type& declarations() const { return *this->block; }
+  std::size_t size() const { return this->block->size(); }
+  bool empty() const { return this->block->empty(); }
+  const_iterator begin() const { return this->block->begin(); }
+  const_iterator end() const { return this->block->end(); }
+  const property_type* find(std::string_view name) const { return this->block->find(name); }
+  const property_type* find(property_id id) const { return this->block->find(id); }
+  template<typename Visitor>
+  void visit(Visitor&& visitor) const
+  {
+    this->block->visit(std::forward<Visitor>(visitor));
+  }
+
+  /// The source order of \a declaration (from this rule's block) as part of this rule.
+  std::uint32_t source_order(const property_type& declaration) const
+  {
+    return declaration.order + this->shift;
+  }
+};
+
+/// How much memory sharing declaration blocks saves (see basic_stylesheet::block_usage()).
+struct block_usage
+{
+  std::size_t rules = 0;        //!< The number of selectors with declarations.
+  std::size_t blocks = 0;       //!< The number of distinct declaration blocks.
+  std::size_t declarations = 0; //!< The number of declarations stored in those blocks.
+  std::size_t references = 0;   //!< The number of declarations that rules refer to.
+  std::size_t saved = 0;        //!< An estimate of the bytes that per-rule copies would have added.
 };
 
 /// State associated with parsing a stylesheet.
-struct stylesheet
+///
+/// With `String = std::string_view`, selectors, property names and
+/// values all refer to the parser's input buffer (e.g., a
+/// css::input::mapped_file), which must outlive the stylesheet. Only
+/// identifiers containing escape sequences are copied (into
+/// `decoded`) so that their unescaped text can be stored.
+///
+/// Every container (and, with `String = std::pmr::string`, every
+/// string) is allocated from the memory resource passed to the
+/// constructor. Pass an css::parser::arena's resource to allocate
+/// the whole parse result from a few large blocks that are released
+/// together; the resource must outlive the stylesheet.
+template<typename String>
+struct basic_stylesheet
 {
-  stylesheet() = default;
+  using string_type = String;
+  using property_type = basic_property<String>;
+  using property_data_type = basic_property_data<String>;
+  using rule_type = basic_rule<String>;
+  using block_type = typename rule_type::block_type;
+
+  explicit basic_stylesheet(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : accumulate(resource)
+    , properties(resource)
+    , blocks(resource)
+    , decoded(resource)
+  {
+  }
+
   bool valid = true;
+  /// When true, shorthands are replaced by their longhands as they are
+  /// parsed (see basic_accumulator::expand_shorthand()).
+  bool expand_shorthands = false;
+  /// The origin recorded in every declaration of the stylesheet.
+  origin source = origin::author;
   std::string encoding = "utf-8";
-  accumulator accumulate;
-  std::unordered_map<std::string, property_data> properties;
+  basic_accumulator<String> accumulate;
+  /// The rule of each selector, whose declaration block may be shared with other selectors.
+  std::pmr::unordered_map<String, rule_type> properties;
+  /// Every distinct declaration block, keyed by block_hash(), for sharing identical blocks.
+  std::pmr::unordered_multimap<std::size_t, block_type> blocks;
+  std::pmr::deque<std::pmr::string> decoded;
+
+  /// The table in which the stylesheet's identifiers are interned.
+  ///
+  /// Every stylesheet uses atom_table::global() unless its accumulator
+  /// is given another table before parsing.
+  atom_table& atoms() const
+  {
+    return *this->accumulate.atoms;
+  }
+
+  /// The memory resource from which the stylesheet allocates.
+  std::pmr::memory_resource* resource() const
+  {
+    return this->properties.get_allocator().resource();
+  }
+
+  /// Return a block with the same declarations as \a declarations, sharing an existing one when possible.
+  ///
+  /// Blocks are the same when their declarations are equal and in the
+  /// same order relative to one another; \a shift is set to what must
+  /// be added to the returned block's declaration orders to give those
+  /// of \a declarations.
+  block_type share(property_data_type&& declarations, std::uint32_t& shift)
+  {
+    const std::uint32_t base = basic_stylesheet::block_base(declarations);
+    const std::size_t hashed = basic_stylesheet::block_hash(declarations, base);
+    auto range = this->blocks.equal_range(hashed);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (basic_stylesheet::same_block(*it->second, declarations, base))
+      {
+        shift = base - basic_stylesheet::block_base(*it->second);
+        return it->second;
+      }
+    }
+    // Constructing through a polymorphic allocator passes the block its memory resource.
+    block_type block = std::allocate_shared<property_data_type>(
+      std::pmr::polymorphic_allocator<property_data_type>(this->resource()), std::move(declarations));
+    this->blocks.emplace(hashed, block);
+    shift = 0;
+    return block;
+  }
+
+  /// Make \a block (whose orders are shifted by \a shift) the declarations of \a selector.
+  ///
+  /// When \a selector already has a rule (it appeared earlier in the
+  /// stylesheet), its rule gets a new block holding its earlier
+  /// declarations overridden by those of \a block (see
+  /// basic_property_data for why important ones are kept).
+  void add_rule(const String& selector, std::uint32_t specificity, const block_type& block, std::uint32_t shift)
+  {
+    auto found = this->properties.find(selector);
+    if (found == this->properties.end())
+    {
+      rule_type added;
+      added.block = block;
+      added.specificity = specificity;
+      added.shift = shift;
+      this->properties.emplace(selector, std::move(added));
+      return;
+    }
+    rule_type& existing = found->second;
+    property_data_type merged(this->resource());
+    for (const auto& p : existing)
+    {
+      property_type copy(p, this->resource());
+      copy.order = existing.source_order(p);
+      merged.insert(std::move(copy));
+    }
+    for (const auto& p : *block)
+    {
+      property_type copy(p, this->resource());
+      copy.order = p.order + shift;
+      merged.insert(std::move(copy));
+    }
+    block_type previous = std::move(existing.block);
+    existing.block = this->share(std::move(merged), existing.shift);
+    existing.specificity = specificity;
+    this->release(previous);
+  }
+
+  /// Forget \a block when no rule refers to it any more.
+  void release(const block_type& block)
+  {
+    // The reference held by blocks and the caller's are the only ones left.
+    if (!block || block.use_count() > 2)
+    {
+      return;
+    }
+    auto range = this->blocks.equal_range(basic_stylesheet::block_hash(*block, basic_stylesheet::block_base(*block)));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == block)
+      {
+        this->blocks.erase(it);
+        return;
+      }
+    }
+  }
+
+  /// Report how many declaration blocks the rules share.
+  parser::block_usage block_usage() const
+  {
+    // Without sharing, each rule would own a copy of its block, including (unless String is a view) its text.
+    auto text = [](const property_data_type& block)
+    {
+      std::size_t bytes = 0;
+      if constexpr (!std::is_same<String, std::string_view>::value)
+      {
+        for (const auto& p : block)
+        {
+          bytes += p.name.size() + p.value.size();
+        }
+      }
+      return bytes;
+    };
+    parser::block_usage usage;
+    usage.rules = this->properties.size();
+    usage.blocks = this->blocks.size();
+    std::size_t stored = 0;
+    for (const auto& entry : this->blocks)
+    {
+      usage.declarations += entry.second->size();
+      stored += text(*entry.second);
+    }
+    std::size_t referenced = 0;
+    for (const auto& entry : this->properties)
+    {
+      usage.references += entry.second.size();
+      referenced += text(entry.second.declarations());
+    }
+    auto excess = [](std::size_t all, std::size_t kept) { return all > kept ? all - kept : 0; };
+    usage.saved =
+      excess(usage.rules, usage.blocks) * sizeof(property_data_type) +
+      excess(usage.references, usage.declarations) * sizeof(property_type) +
+      excess(referenced, stored);
+    return usage;
+  }
+
+  /// Return the matched text from \a begin to \a end.
+  String text(const char* begin, const char* end)
+  {
+    return make_string<String>(std::string_view(begin, static_cast<std::size_t>(end - begin)), this->resource());
+  }
+
+  /// Return the matched identifier from \a begin to \a end with any escapes decoded.
+  String identifier(const char* begin, const char* end)
+  {
+    std::string_view raw(begin, static_cast<std::size_t>(end - begin));
+    if (!has_escapes(raw))
+    {
+      return make_string<String>(raw, this->resource());
+    }
+    std::string unescaped = unescape(raw);
+    if constexpr (std::is_same<String, std::string_view>::value)
+    {
+      this->decoded.emplace_back(unescaped.data(), unescaped.size());
+      return String(this->decoded.back());
+    }
+    else
+    {
+      return make_string<String>(unescaped, this->resource());
+    }
+  }
+
+  /// Return a copy of \a text (owned by \a other) that is valid for this stylesheet's lifetime.
+  String adopt(const String& text, const basic_stylesheet& other)
+  {
+    if constexpr (std::is_same<String, std::string_view>::value)
+    {
+      // Only decoded identifiers refer to the other stylesheet's storage.
+      for (const auto& entry : other.decoded)
+      {
+        if (text.data() >= entry.data() && text.data() <= entry.data() + entry.size())
+        {
+          this->decoded.emplace_back(text.data(), text.size());
+          return String(this->decoded.back());
+        }
+      }
+      return text;
+    }
+    else
+    {
+      return make_string<String>(std::string_view(text), this->resource());
+    }
+  }
+
+  /// Return a copy of \a typed (from \a other) whose identifiers are interned in this stylesheet's table.
+  compact_value adopt_atoms(const compact_value& typed, const basic_stylesheet& other)
+  {
+    compact_value result(this->resource());
+    for (parser::component item : typed)
+    {
+      if (item.type == value_type::ident)
+      {
+        item.name = this->atoms().intern(other.atoms().text(item.name));
+      }
+      result.push_back(item);
+    }
+    return result;
+  }
+
+  /// Add the rules parsed into \a other as if its text had followed this stylesheet's.
+  ///
+  /// Merging the stylesheets of consecutive pieces of a file in order
+  /// produces the same properties as parsing the whole file at once
+  /// (including the source order of their declarations).
+  void merge(const basic_stylesheet& other)
+  {
+    this->valid &= other.valid;
+    this->accumulate.interned += other.accumulate.interned;
+    const std::uint32_t preceding = this->accumulate.declarations;
+    this->accumulate.declarations += other.accumulate.declarations;
+    // Convert each of the other stylesheet's blocks once, however many rules share it.
+    std::unordered_map<const property_data_type*, std::pair<block_type, std::uint32_t>> converted;
+    for (const auto& entry : other.properties)
+    {
+      auto found = converted.find(entry.second.block.get());
+      if (found == converted.end())
+      {
+        property_data_type declarations(this->resource());
+        for (const auto& p : entry.second)
+        {
+          property_type copy(this->resource());
+          copy.name = this->adopt(p.name, other);
+          copy.id = p.id;
+          copy.value = this->adopt(p.value, other);
+          copy.typed = p.typed;
+          if (&other.atoms() != &this->atoms())
+          {
+            copy.typed = this->adopt_atoms(p.typed, other);
+          }
+          copy.source = p.source;
+          copy.important = p.important;
+          copy.order = p.order + preceding;
+          declarations.insert(std::move(copy));
+        }
+        std::uint32_t shift = 0;
+        block_type block = this->share(std::move(declarations), shift);
+        found = converted.emplace(entry.second.block.get(), std::make_pair(std::move(block), shift)).first;
+      }
+      this->add_rule(this->adopt(entry.first, other), entry.second.specificity,
+        found->second.first, found->second.second + entry.second.shift);
+    }
+    for (const auto& entry : converted)
+    {
+      this->release(entry.second.first);
+    }
+  }
+
+protected:
+  /// The lowest order of the declarations in \a block (0 when it is empty).
+  static std::uint32_t block_base(const property_data_type& block)
+  {
+    std::uint32_t base = 0;
+    bool first = true;
+    for (const auto& p : block)
+    {
+      base = first || p.order < base ? p.order : base;
+      first = false;
+    }
+    return base;
+  }
+
+  /// Hash the declarations of \a block, with their orders relative to \a base.
+  static std::size_t block_hash(const property_data_type& block, std::uint32_t base)
+  {
+    std::size_t result = block.size();
+    for (const auto& p : block)
+    {
+      std::size_t each = property_key_hash(p.id, p.name);
+      each = each * 31 + std::hash<std::string_view>()(std::string_view(p.value));
+      each = each * 31 + (p.order - base);
+      each = each * 31 + (static_cast<std::size_t>(p.source) << 1 | (p.important ? 1 : 0));
+      result = result * 0x9e3779b97f4a7c15ull + each;
+    }
+    return result;
+  }
+
+  /// Returns true when \a block holds the same declarations as \a other (whose lowest order is \a base).
+  static bool same_block(const property_data_type& block, const property_data_type& other, std::uint32_t base)
+  {
+    if (block.size() != other.size())
+    {
+      return false;
+    }
+    const std::uint32_t blockBase = basic_stylesheet::block_base(block);
+    auto it = other.begin();
+    for (const auto& p : block)
+    {
+      const auto& q = *it++;
+      if (p.id != q.id || !property_name_equal(p.name, q.name) || std::string_view(p.value) != std::string_view(q.value) ||
+        p.source != q.source || p.important != q.important || p.order - blockBase != q.order - base)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
 };
 
+/// A stylesheet that owns all of its text.
+using stylesheet = basic_stylesheet<std::string>;
+/// A stylesheet that refers to its (kept-alive) input buffer.
+using stylesheet_view = basic_stylesheet<std::string_view>;
+
+namespace pmr
+{
+/// A stylesheet that owns its text but allocates it from a memory resource.
+using stylesheet = basic_stylesheet<std::pmr::string>;
+}
+
 } // namespace parser
 } // namespace css
 
@@ -113,11 +1241,11 @@ namespace std
 {
 
 /// Provide a specialization for hashing properties.
-template <> struct hash<css::parser::property>
+template <typename String> struct hash<css::parser::basic_property<String>>
 {
-  size_t operator()(const css::parser::property& p) const
+  size_t operator()(const css::parser::basic_property<String>& p) const
   {
-    return std::hash<std::string>{}(p.name);
+    return css::parser::property_name_hash(p.name);
   }
 };
 
@@ -0,0 +1,427 @@
+#ifndef css_parser_value_h
+#define css_parser_value_h
+#include "css/parser/atom.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace css
+{
+namespace parser
+{
+
+/// The units a numeric value component may carry.
+enum class unit : std::uint8_t
+{
+  none,    //!< A plain number.
+  percent, //!< A percentage.
+  px,
+  cm,
+  mm,
+  in,
+  pt,
+  pc,
+  em,
+  ex,
+  deg,
+  rad,
+  grad,
+  ms,
+  s,
+  hz,
+  khz,
+  other    //!< A dimension with units not listed here (see the component's text).
+};
+
+/// Compare \a text to the lower-case \a name, ignoring ASCII case.
+inline bool equal_ignoring_case(std::string_view text, std::string_view name)
+{
+  if (text.size() != name.size())
+  {
+    return false;
+  }
+  for (std::size_t ii = 0; ii < text.size(); ++ii)
+  {
+    auto cc = static_cast<unsigned char>(text[ii]);
+    if (cc >= 'A' && cc <= 'Z')
+    {
+      cc |= 0x20;
+    }
+    if (cc != static_cast<unsigned char>(name[ii]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// The lower-case name of \a units ("" for unit::none and unit::other).
+inline std::string_view unit_name(unit units)
+{
+  static const std::string_view names[] = {
+    "", "%", "px", "cm", "mm", "in", "pt", "pc", "em", "ex",
+    "deg", "rad", "grad", "ms", "s", "hz", "khz", ""
+  };
+  return names[static_cast<std::size_t>(units)];
+}
+
+/// Return the unit named by \a suffix (ignoring ASCII case) or unit::other.
+inline unit unit_from_suffix(std::string_view suffix)
+{
+  if (suffix.empty())
+  {
+    return unit::none;
+  }
+  for (auto ii = static_cast<std::uint8_t>(unit::percent); ii < static_cast<std::uint8_t>(unit::other); ++ii)
+  {
+    if (equal_ignoring_case(suffix, unit_name(static_cast<unit>(ii))))
+    {
+      return static_cast<unit>(ii);
+    }
+  }
+  return unit::other;
+}
+
+/// Identifiers that commonly appear as property values.
+///
+/// These are stored as small integer IDs rather than text.
+/// Entries must stay in the (alphabetical) order of keyword_names().
+enum class keyword : std::uint16_t
+{
+  unknown,
+  absolute,
+  auto_,
+  block,
+  bold,
+  both,
+  center,
+  currentcolor,
+  dashed,
+  fixed,
+  flex,
+  grid,
+  hidden,
+  inherit,
+  initial,
+  inline_,
+  inline_block,
+  italic,
+  left,
+  none,
+  normal,
+  nowrap,
+  pointer,
+  relative,
+  right,
+  scroll,
+  solid,
+  static_,
+  sticky,
+  transparent,
+  unset,
+  visible
+};
+
+/// The lower-case names of keywords, indexed by css::parser::keyword.
+inline const std::string_view* keyword_names()
+{
+  static const std::string_view names[] = {
+    "",
+    "absolute", "auto", "block", "bold", "both", "center", "currentcolor",
+    "dashed", "fixed", "flex", "grid", "hidden", "inherit", "initial",
+    "inline", "inline-block", "italic", "left", "none", "normal", "nowrap",
+    "pointer", "relative", "right", "scroll", "solid", "static", "sticky",
+    "transparent", "unset", "visible"
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) == static_cast<std::size_t>(keyword::visible) + 1,
+    "keyword_names() must name every keyword");
+  return names;
+}
+
+/// The lower-case name of \a word.
+inline std::string_view keyword_name(keyword word)
+{
+  return keyword_names()[static_cast<std::size_t>(word)];
+}
+
+/// Return the keyword named by \a text (ignoring ASCII case) or keyword::unknown.
+inline keyword keyword_from_ident(std::string_view text)
+{
+  const std::string_view* names = keyword_names();
+  std::size_t lo = 1;
+  std::size_t hi = static_cast<std::size_t>(keyword::visible) + 1;
+  char folded[16];
+  if (text.size() > sizeof(folded))
+  {
+    return keyword::unknown;
+  }
+  for (std::size_t ii = 0; ii < text.size(); ++ii)
+  {
+    char cc = text[ii];
+    folded[ii] = (cc >= 'A' && cc <= 'Z') ? static_cast<char>(cc | 0x20) : cc;
+  }
+  std::string_view key(folded, text.size());
+  while (lo < hi)
+  {
+    std::size_t mid = (lo + hi) / 2;
+    if (names[mid] < key)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return (lo <= static_cast<std::size_t>(keyword::visible) && names[lo] == key) ?
+    static_cast<keyword>(lo) : keyword::unknown;
+}
+
+/// The kinds of value components.
+enum class value_type : std::uint8_t
+{
+  number,   //!< A number, percentage or dimension (see component::number and component::units).
+  color,    //!< A hex color (see component::rgba).
+  keyword,  //!< A known keyword (see component::word).
+  ident,    //!< Any other identifier (see component::name).
+  hash,     //!< A hash that is not a valid hex color.
+  string,   //!< A quoted string (the text includes the quotes).
+  url,      //!< A url(...) token.
+  function  //!< A function call (the text includes its arguments).
+};
+
+/// One term of a property value in compact binary form.
+///
+/// Every component records where its text lies within the property's
+/// value string so that consumers may fall back to the text (e.g., for
+/// an unknown unit, an identifier or a function's arguments).
+struct component
+{
+  union
+  {
+    double number;       //!< The value of a value_type::number component.
+    std::uint32_t rgba;  //!< A value_type::color as 0xRRGGBBAA.
+    keyword word;        //!< The ID of a value_type::keyword component.
+    atom name;           //!< The interned (unescaped) text of a value_type::ident component.
+  };
+  std::uint32_t offset = 0; //!< The offset of the component's text in the value.
+  std::uint32_t length = 0; //!< The length of the component's text.
+  value_type type = value_type::ident;
+  unit units = unit::none; //!< The units of a value_type::number component.
+
+  component() : number(0.0) {}
+
+  /// The component's text, given the \a value string it was parsed from.
+  std::string_view text(std::string_view value) const
+  {
+    return value.substr(this->offset, this->length);
+  }
+};
+
+static_assert(sizeof(component) <= 24, "value components should stay compact");
+
+/// Parse the hex digits of a color into 0xRRGGBBAA.
+///
+/// Returns false unless \a digits holds 3, 4, 6 or 8 hex digits.
+inline bool parse_hex_color(std::string_view digits, std::uint32_t& rgba)
+{
+  std::uint32_t nibbles[8];
+  for (std::size_t ii = 0; ii < digits.size() && ii < 8; ++ii)
+  {
+    auto cc = static_cast<unsigned char>(digits[ii]);
+    if (cc >= '0' && cc <= '9')
+    {
+      nibbles[ii] = cc - '0';
+    }
+    else if ((cc | 0x20) >= 'a' && (cc | 0x20) <= 'f')
+    {
+      nibbles[ii] = (cc | 0x20) - 'a' + 10;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  switch (digits.size())
+  {
+  case 3:
+  case 4:
+    rgba = 0;
+    for (std::size_t ii = 0; ii < 4; ++ii)
+    {
+      std::uint32_t nibble = ii < digits.size() ? nibbles[ii] : 0xf;
+      rgba = (rgba << 8) | (nibble << 4) | nibble;
+    }
+    return true;
+  case 6:
+  case 8:
+    rgba = 0;
+    for (std::size_t ii = 0; ii < 8; ++ii)
+    {
+      rgba = (rgba << 4) | (ii < digits.size() ? nibbles[ii] : 0xf);
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// The components of a property value.
+///
+/// Up to \a inline_capacity components (enough for most values, such
+/// as `12px` or `0 auto`) are stored inside the object; longer values
+/// move to an array allocated from the value's memory resource. Values
+/// with more than \a max_components components exceed the size budget
+/// and keep only their text: all components are dropped and
+/// overflowed() returns true.
+class compact_value
+{
+public:
+  using allocator_type = std::pmr::polymorphic_allocator<component>;
+  using const_iterator = const component*;
+  static constexpr std::size_t inline_capacity = 2;
+  static constexpr std::size_t max_components = 32;
+
+  compact_value() = default;
+  explicit compact_value(const allocator_type& alloc)
+    : m_spill(alloc)
+  {
+  }
+  /// Copies use the memory resource the source's allocator selects for
+  /// copies (the default resource), as `std::pmr` containers do.
+  compact_value(const compact_value& other)
+    : compact_value(other,
+        std::allocator_traits<allocator_type>::select_on_container_copy_construction(other.get_allocator()))
+  {
+  }
+  /// Moves keep the source's memory resource and never allocate, so
+  /// containers of values (and of properties) move them when they grow.
+  compact_value(compact_value&& other) noexcept
+    : m_size(other.m_size)
+    , m_overflow(other.m_overflow)
+    , m_spill(std::move(other.m_spill))
+  {
+    std::copy(other.m_inline, other.m_inline + inline_capacity, m_inline);
+    other.clear();
+  }
+  compact_value(const compact_value& other, const allocator_type& alloc)
+    : m_size(other.m_size)
+    , m_overflow(other.m_overflow)
+    , m_spill(other.m_spill, alloc)
+  {
+    std::copy(other.m_inline, other.m_inline + inline_capacity, m_inline);
+  }
+  compact_value(compact_value&& other, const allocator_type& alloc)
+    : m_size(other.m_size)
+    , m_overflow(other.m_overflow)
+    , m_spill(alloc)
+  {
+    this->take_spill(std::move(other.m_spill));
+    std::copy(other.m_inline, other.m_inline + inline_capacity, m_inline);
+    other.clear();
+  }
+  compact_value& operator = (const compact_value&) = default;
+  /// Assignment keeps this value's memory resource. When the resources
+  /// differ the components are copied; failing to allocate them terminates.
+  compact_value& operator = (compact_value&& other) noexcept
+  {
+    if (this != &other)
+    {
+      m_size = other.m_size;
+      m_overflow = other.m_overflow;
+      this->take_spill(std::move(other.m_spill));
+      std::copy(other.m_inline, other.m_inline + inline_capacity, m_inline);
+      other.clear();
+    }
+    return *this;
+  }
+
+  allocator_type get_allocator() const { return m_spill.get_allocator(); }
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  /// Returns true when the value had too many components to store.
+  bool overflowed() const { return m_overflow; }
+
+  const_iterator begin() const
+  {
+    return m_size <= inline_capacity ? m_inline : m_spill.data();
+  }
+  const_iterator end() const
+  {
+    return this->begin() + m_size;
+  }
+  const component& operator [] (std::size_t ii) const
+  {
+    return this->begin()[ii];
+  }
+
+  /// Append \a item; returns false (dropping every component) once the budget is exceeded.
+  bool push_back(const component& item)
+  {
+    if (m_overflow)
+    {
+      return false;
+    }
+    if (m_size == max_components)
+    {
+      this->clear();
+      m_overflow = true;
+      return false;
+    }
+    if (m_size < inline_capacity)
+    {
+      m_inline[m_size++] = item;
+      return true;
+    }
+    if (m_size == inline_capacity)
+    {
+      m_spill.assign(m_inline, m_inline + inline_capacity);
+    }
+    m_spill.push_back(item);
+    ++m_size;
+    return true;
+  }
+
+  void clear()
+  {
+    m_spill.clear();
+    m_size = 0;
+    m_overflow = false;
+  }
+
+protected:
+  /// Take the array of \a spill when it shares our memory resource; otherwise copy it.
+  void take_spill(std::pmr::vector<component>&& spill)
+  {
+    if (spill.get_allocator() == m_spill.get_allocator())
+    {
+      m_spill.swap(spill);
+      spill.clear();
+    }
+    else
+    {
+      m_spill.assign(spill.begin(), spill.end());
+    }
+  }
+
+  std::uint32_t m_size = 0;
+  bool m_overflow = false;
+  component m_inline[inline_capacity];
+  std::pmr::vector<component> m_spill;
+};
+
+static_assert(std::is_nothrow_move_constructible<compact_value>::value,
+  "vectors of properties only move their elements when moving them cannot throw");
+
+} // namespace parser
+} // namespace css
+
+#endif // css_parser_value_h
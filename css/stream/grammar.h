@@ -0,0 +1,111 @@
+#ifndef css_stream_grammar_h
+#define css_stream_grammar_h
+#include "css/composite/grammar.h"
+
+#include <istream>
+
+namespace css
+{
+
+/// Rules for parsing stylesheets incrementally from a stream.
+///
+/// These rules accept the same language as css::composite::stylesheet
+/// but discard the input buffer after each top-level ruleset, each
+/// ruleset nested in a media block, and each page block, so they may
+/// be used with PEGTL's buffered inputs (see css::stream::input).
+///
+/// The input consumed by the parser never exceeds the window size
+/// passed to the input plus `chunk_size` bytes, independent of the
+/// size of the stylesheet. The largest single ruleset (or `@page`
+/// block, or `@media` prelude) plus the lookahead needed to finish
+/// it must fit in the window; otherwise the input throws an
+/// exception. Note that the parsed stylesheet state itself still
+/// grows with the number of distinct selectors and properties.
+///
+/// Once the buffer has been discarded, the input of a rule that spans
+/// the discard (these rules, and the PEGTL combinators inside them
+/// that repeat or dispatch to rulesets) no longer refers to the bytes
+/// it matched, so no action may be attached to such a rule. The
+/// actions in css/parser/actions.h only apply to rules inside a
+/// ruleset, but the generic action printed when `CSS_DBG_PARSE` is
+/// set applies to every rule; parse these rules with an action that
+/// does nothing in that configuration.
+namespace stream
+{
+
+/// The number of bytes read from the stream at a time.
+constexpr std::size_t chunk_size = 4096;
+
+/// The default window size (maximum number of buffered bytes).
+constexpr std::size_t default_window = std::size_t(1) << 20;
+
+/// A buffered input reading from a std::istream (including std::cin).
+using input = rule::istream_input<rule::eol::lf_crlf, chunk_size>;
+
+/// A media block that discards each nested ruleset once it is parsed.
+///
+/// Because bytes before a discard can no longer be re-read, the body
+/// of the media block is mandatory once its opening brace has been
+/// seen; a malformed body raises a parse error rather than
+/// backtracking.
+struct media :
+  rule::if_must<
+    rule::seq<
+      token::media_keyword,
+      token::whitespace,
+      composite::media_list,
+      token::curly_open
+    >,
+    token::optional_whitespace,
+    rule::star<
+      composite::ruleset,
+      rule::discard
+    >,
+    token::curly_close,
+    token::optional_whitespace
+  >
+{
+};
+
+/// A stylesheet that discards its input buffer at ruleset boundaries.
+struct stylesheet :
+  rule::seq<
+    rule::opt<token::encoding>,
+    rule::star<
+      rule::sor<
+        token::whitespace,
+        token::CDO,
+        token::CDC
+      >
+    >,
+    composite::import_rules,
+    rule::discard,
+    rule::star<
+      token::dispatch_sor<
+        composite::ruleset,
+        stream::media,
+        composite::page
+      >,
+      rule::discard,
+      rule::star<
+        rule::sor<
+          rule::seq<
+            token::CDO,
+            token::optional_whitespace
+          >,
+          rule::seq<
+            token::CDC,
+            token::optional_whitespace
+          >
+        >
+      >
+    >,
+    rule::eof
+  >
+{
+};
+
+} // stream namespace
+} // css namespace
+
+#endif // css_stream_grammar_h
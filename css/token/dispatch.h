@@ -0,0 +1,439 @@
+#ifndef css_token_dispatch_h
+#define css_token_dispatch_h
+#include "css/config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace css
+{
+namespace token
+{
+
+/// A set of bytes (e.g., the bytes a rule may begin with).
+struct byte_set
+{
+  std::uint64_t words[4] = { 0, 0, 0, 0 };
+
+  constexpr bool contains(unsigned char cc) const
+  {
+    return (this->words[cc >> 6] >> (cc & 63)) & 1;
+  }
+  constexpr byte_set& insert(unsigned char cc)
+  {
+    this->words[cc >> 6] |= std::uint64_t(1) << (cc & 63);
+    return *this;
+  }
+  constexpr byte_set& insert(unsigned lo, unsigned hi)
+  {
+    for (unsigned cc = lo; cc <= hi && cc < 256; ++cc)
+    {
+      this->insert(static_cast<unsigned char>(cc));
+    }
+    return *this;
+  }
+  constexpr byte_set& merge(const byte_set& other)
+  {
+    for (std::size_t ii = 0; ii < 4; ++ii)
+    {
+      this->words[ii] |= other.words[ii];
+    }
+    return *this;
+  }
+  static constexpr byte_set all()
+  {
+    byte_set result;
+    return result.insert(0, 255);
+  }
+};
+
+/// The FIRST set of a rule: the bytes a match may begin with, and
+/// whether the rule may succeed without consuming input (in which
+/// case it may succeed whatever the next byte is, or at the end).
+///
+/// FIRST sets are conservative: they may contain bytes that cannot
+/// actually begin a match, but never omit one that can.
+struct first_set
+{
+  byte_set bytes;
+  bool nullable = false;
+
+  static constexpr first_set of_bytes(const byte_set& bytes)
+  {
+    first_set result;
+    result.bytes = bytes;
+    return result;
+  }
+  /// The FIRST set of a rule about which nothing is known.
+  static constexpr first_set unknown()
+  {
+    first_set result;
+    result.bytes = byte_set::all();
+    result.nullable = true;
+    return result;
+  }
+  /// The FIRST set of a rule that only succeeds without consuming input.
+  static constexpr first_set empty()
+  {
+    first_set result;
+    result.nullable = true;
+    return result;
+  }
+};
+
+/// Add the bytes that may begin the UTF-8 encoding of code-points in [\a lo, \a hi].
+constexpr byte_set& insert_code_points(byte_set& bytes, char32_t lo, char32_t hi)
+{
+  if (lo < 0x80)
+  {
+    bytes.insert(static_cast<unsigned>(lo), static_cast<unsigned>(hi < 0x80 ? hi : 0x7f));
+  }
+  if (hi >= 0x80)
+  {
+    // Any lead byte; precision is not worth the trouble here.
+    bytes.insert(0x80, 0xff);
+  }
+  return bytes;
+}
+
+constexpr unsigned char other_case(unsigned char cc)
+{
+  return ((cc | 0x20) >= 'a' && (cc | 0x20) <= 'z') ? static_cast<unsigned char>(cc ^ 0x20) : cc;
+}
+
+// Compute FIRST sets by overload resolution on a pointer to the rule:
+// a grammar rule such as `struct term : rule::sor<...>` converts to a
+// pointer to its PEGTL base class, so the matching overload below is
+// chosen. Hand-written rules provide a static `first()` member instead.
+// Anything else gets first_set::unknown(), so it is always tried.
+//
+// All overloads are declared before any is defined so that they can
+// find each other regardless of how rules nest.
+
+constexpr first_set first_of(const void*);
+template<typename Rule>
+constexpr auto first_of(const Rule*) -> decltype(Rule::first());
+template<typename... Rules>
+constexpr first_set first_of(const rule::seq<Rules...>*);
+template<typename... Rules>
+constexpr first_set first_of(const rule::sor<Rules...>*);
+template<typename... Rules>
+constexpr first_set first_of(const rule::opt<Rules...>*);
+template<typename... Rules>
+constexpr first_set first_of(const rule::star<Rules...>*);
+template<typename... Rules>
+constexpr first_set first_of(const rule::plus<Rules...>*);
+template<typename Cond, typename... Rules>
+constexpr first_set first_of(const rule::if_must<Cond, Rules...>*);
+template<typename Rule, typename Except>
+constexpr first_set first_of(const rule::minus<Rule, Except>*);
+template<unsigned Min, unsigned Max, typename... Rules>
+constexpr first_set first_of(const rule::rep_min_max<Min, Max, Rules...>*);
+template<char C, char... Cs>
+constexpr first_set first_of(const rule::string<C, Cs...>*);
+template<char C, char... Cs>
+constexpr first_set first_of(const rule::istring<C, Cs...>*);
+template<char... Cs>
+constexpr first_set first_of(const rule::one<Cs...>*);
+template<char32_t C, char32_t... Cs>
+constexpr first_set first_of(const rule::utf8::string<C, Cs...>*);
+template<char32_t... Cs>
+constexpr first_set first_of(const rule::utf8::one<Cs...>*);
+template<char32_t Lo, char32_t Hi>
+constexpr first_set first_of(const rule::utf8::range<Lo, Hi>*);
+template<char32_t... Cs>
+constexpr first_set first_of(const rule::utf8::ranges<Cs...>*);
+constexpr first_set first_of(const rule::ascii::digit*);
+constexpr first_set first_of(const rule::eof*);
+constexpr first_set first_of(const rule::success*);
+constexpr first_set first_of(const rule::discard*);
+
+/// The FIRST set of \a Rule.
+template<typename Rule>
+constexpr first_set first()
+{
+  return first_of(static_cast<const Rule*>(nullptr));
+}
+
+/// The FIRST set of the sequence \a Rule, \a Rules...
+template<typename Rule, typename... Rules>
+constexpr first_set first_of_seq()
+{
+  first_set result = token::first<Rule>();
+  if constexpr (sizeof...(Rules) > 0)
+  {
+    if (result.nullable)
+    {
+      first_set rest = token::first_of_seq<Rules...>();
+      result.bytes.merge(rest.bytes);
+      result.nullable = rest.nullable;
+    }
+  }
+  return result;
+}
+
+constexpr first_set first_of(const void*)
+{
+  return first_set::unknown();
+}
+
+template<typename Rule>
+constexpr auto first_of(const Rule*) -> decltype(Rule::first())
+{
+  return Rule::first();
+}
+
+template<typename... Rules>
+constexpr first_set first_of(const rule::seq<Rules...>*)
+{
+  if constexpr (sizeof...(Rules) == 0)
+  {
+    return first_set::empty();
+  }
+  else
+  {
+    return token::first_of_seq<Rules...>();
+  }
+}
+
+template<typename... Rules>
+constexpr first_set first_of(const rule::sor<Rules...>*)
+{
+  first_set result;
+  const first_set alternatives[] = { first_set(), token::first<Rules>()... };
+  for (const auto& alternative : alternatives)
+  {
+    result.bytes.merge(alternative.bytes);
+    result.nullable |= alternative.nullable;
+  }
+  return result;
+}
+
+template<typename... Rules>
+constexpr first_set first_of(const rule::opt<Rules...>*)
+{
+  first_set result = token::first_of(static_cast<const rule::seq<Rules...>*>(nullptr));
+  result.nullable = true;
+  return result;
+}
+
+template<typename... Rules>
+constexpr first_set first_of(const rule::star<Rules...>*)
+{
+  first_set result = token::first_of(static_cast<const rule::seq<Rules...>*>(nullptr));
+  result.nullable = true;
+  return result;
+}
+
+template<typename... Rules>
+constexpr first_set first_of(const rule::plus<Rules...>*)
+{
+  return token::first_of(static_cast<const rule::seq<Rules...>*>(nullptr));
+}
+
+// if_must only raises once its condition has matched, so it fails
+// quietly on bytes outside the condition's FIRST set.
+template<typename Cond, typename... Rules>
+constexpr first_set first_of(const rule::if_must<Cond, Rules...>*)
+{
+  return token::first_of_seq<Cond, Rules...>();
+}
+
+template<typename Rule, typename Except>
+constexpr first_set first_of(const rule::minus<Rule, Except>*)
+{
+  return token::first<Rule>();
+}
+
+template<unsigned Min, unsigned Max, typename... Rules>
+constexpr first_set first_of(const rule::rep_min_max<Min, Max, Rules...>*)
+{
+  first_set result = token::first_of(static_cast<const rule::seq<Rules...>*>(nullptr));
+  result.nullable |= Min == 0;
+  return result;
+}
+
+template<char C, char... Cs>
+constexpr first_set first_of(const rule::string<C, Cs...>*)
+{
+  return first_set::of_bytes(byte_set().insert(static_cast<unsigned char>(C)));
+}
+
+template<char C, char... Cs>
+constexpr first_set first_of(const rule::istring<C, Cs...>*)
+{
+  const auto cc = static_cast<unsigned char>(C);
+  return first_set::of_bytes(byte_set().insert(cc).insert(token::other_case(cc)));
+}
+
+template<char... Cs>
+constexpr first_set first_of(const rule::one<Cs...>*)
+{
+  byte_set bytes;
+  const char chars[] = { Cs..., 0 };
+  for (std::size_t ii = 0; ii < sizeof...(Cs); ++ii)
+  {
+    bytes.insert(static_cast<unsigned char>(chars[ii]));
+  }
+  return first_set::of_bytes(bytes);
+}
+
+template<char32_t C, char32_t... Cs>
+constexpr first_set first_of(const rule::utf8::string<C, Cs...>*)
+{
+  byte_set bytes;
+  return first_set::of_bytes(token::insert_code_points(bytes, C, C));
+}
+
+template<char32_t... Cs>
+constexpr first_set first_of(const rule::utf8::one<Cs...>*)
+{
+  byte_set bytes;
+  const char32_t code_points[] = { Cs..., 0 };
+  for (std::size_t ii = 0; ii < sizeof...(Cs); ++ii)
+  {
+    token::insert_code_points(bytes, code_points[ii], code_points[ii]);
+  }
+  return first_set::of_bytes(bytes);
+}
+
+template<char32_t Lo, char32_t Hi>
+constexpr first_set first_of(const rule::utf8::range<Lo, Hi>*)
+{
+  byte_set bytes;
+  return first_set::of_bytes(token::insert_code_points(bytes, Lo, Hi));
+}
+
+template<char32_t... Cs>
+constexpr first_set first_of(const rule::utf8::ranges<Cs...>*)
+{
+  // Pairs of bounds, optionally followed by a single code-point.
+  byte_set bytes;
+  const char32_t bounds[] = { Cs..., 0 };
+  std::size_t ii = 0;
+  for (; ii + 1 < sizeof...(Cs); ii += 2)
+  {
+    token::insert_code_points(bytes, bounds[ii], bounds[ii + 1]);
+  }
+  if (ii < sizeof...(Cs))
+  {
+    token::insert_code_points(bytes, bounds[ii], bounds[ii]);
+  }
+  return first_set::of_bytes(bytes);
+}
+
+constexpr first_set first_of(const rule::ascii::digit*)
+{
+  return first_set::of_bytes(byte_set().insert('0', '9'));
+}
+
+constexpr first_set first_of(const rule::eof*)
+{
+  return first_set::empty();
+}
+
+constexpr first_set first_of(const rule::success*)
+{
+  return first_set::empty();
+}
+
+constexpr first_set first_of(const rule::discard*)
+{
+  return first_set::empty();
+}
+
+/// An ordered choice that uses the next byte of input to skip
+/// alternatives that cannot match.
+///
+/// This accepts exactly what `rule::sor<Rules...>` accepts: viable
+/// alternatives are still tried in order, and an alternative is only
+/// skipped when the next byte is outside its FIRST set (so it would
+/// fail without consuming anything). The table of viable alternatives
+/// per byte is computed at compile time.
+template<typename... Rules>
+struct dispatch_sor
+{
+  static_assert(sizeof...(Rules) <= 64, "dispatch_sor supports at most 64 alternatives");
+
+  using analyze_t = rule::analysis::generic<rule::analysis::rule_type::SOR, Rules...>;
+
+  /// Bit \a i of entry \a b is set when alternative \a i may match input beginning with byte \a b.
+  /// The last entry holds the alternatives that may match at the end of input.
+  struct table_type
+  {
+    std::uint64_t viable[257] = {};
+  };
+
+  static constexpr table_type make_table()
+  {
+    table_type table;
+    const first_set alternatives[] = { token::first<Rules>()... };
+    for (std::size_t ii = 0; ii < sizeof...(Rules); ++ii)
+    {
+      const std::uint64_t bit = std::uint64_t(1) << ii;
+      for (unsigned cc = 0; cc < 256; ++cc)
+      {
+        if (alternatives[ii].nullable || alternatives[ii].bytes.contains(static_cast<unsigned char>(cc)))
+        {
+          table.viable[cc] |= bit;
+        }
+      }
+      if (alternatives[ii].nullable)
+      {
+        table.viable[256] |= bit;
+      }
+    }
+    return table;
+  }
+
+  static constexpr first_set first()
+  {
+    first_set result;
+    const first_set alternatives[] = { first_set(), token::first<Rules>()... };
+    for (const auto& alternative : alternatives)
+    {
+      result.bytes.merge(alternative.bytes);
+      result.nullable |= alternative.nullable;
+    }
+    return result;
+  }
+
+  template<
+    rule::apply_mode A,
+    rule::rewind_mode M,
+    template<typename...> class Action,
+    template<typename...> class Control,
+    typename Input,
+    typename... States>
+  static bool match(Input& in, States&&... st)
+  {
+    // Computed here, rather than as a member, so that every rule is complete.
+    static constexpr table_type table = make_table();
+    const std::uint64_t viable = in.empty() ?
+      table.viable[256] :
+      table.viable[static_cast<unsigned char>(in.peek_char())];
+    return dispatch_sor::match_viable<A, M, Action, Control>(
+      viable, std::index_sequence_for<Rules...>(), in, st...);
+  }
+
+protected:
+  template<
+    rule::apply_mode A,
+    rule::rewind_mode M,
+    template<typename...> class Action,
+    template<typename...> class Control,
+    std::size_t... Indices,
+    typename Input,
+    typename... States>
+  static bool match_viable(std::uint64_t viable, std::index_sequence<Indices...>, Input& in, States&&... st)
+  {
+    return ((((viable >> Indices) & 1) != 0 &&
+        Control<Rules>::template match<A, rule::rewind_mode::REQUIRED, Action, Control>(in, st...)) || ...);
+  }
+};
+
+} // token namespace
+} // css namespace
+
+#endif // css_token_dispatch_h
@@ -1,6 +1,9 @@
 #ifndef css_token_grammar_h
 #define css_token_grammar_h
 #include "css/config.h"
+#include "css/token/dispatch.h"
+#include "css/token/keyword.h"
+#include "css/token/scan.h"
 
 namespace css
 {
@@ -43,16 +46,87 @@ struct bad_comment :
 /// One or more whitespace code-points.
 ///
 /// We also match comments as whitespace.
-struct whitespace :
-  rule::plus<
-    rule::sor<
-      rule::utf8::icu::white_space,
-      token::comment,
-      token::bad_comment,
-      token::newline
-    >
-  >
-{
+///
+/// This accepts exactly what
+/// `rule::plus<rule::sor<rule::utf8::icu::white_space, token::comment, token::bad_comment, token::newline>>`
+/// accepts, but skips runs of ASCII whitespace and the bodies of
+/// comments with vectorized scans (see css::scan), only decoding
+/// UTF-8 and consulting ICU when a non-ASCII byte is encountered.
+struct whitespace
+{
+  using analyze_t = rule::analysis::generic<rule::analysis::rule_type::ANY>;
+
+  static constexpr first_set first()
+  {
+    return first_set::of_bytes(byte_set().insert('\t', '\r').insert(' ').insert('/').insert(0x80, 0xff));
+  }
+
+  template<typename Input>
+  static bool match(Input& in)
+  {
+    bool matched = false;
+    for (;;)
+    {
+      const std::size_t available = in.size(scan::block);
+      if (available == 0)
+      {
+        break;
+      }
+      const char* begin = in.current();
+      const char* stop = scan::skip_ascii_whitespace(begin, begin + available);
+      if (stop != begin)
+      {
+        in.bump(static_cast<std::size_t>(stop - begin));
+        matched = true;
+        continue;
+      }
+      const auto lead = static_cast<unsigned char>(*begin);
+      if (lead == '/' && available >= 2 && begin[1] == '*' && whitespace::match_comment(in))
+      {
+        matched = true;
+        continue;
+      }
+      if (lead >= 0x80 && rule::utf8::icu::white_space::match(in))
+      {
+        matched = true;
+        continue;
+      }
+      break;
+    }
+    return matched;
+  }
+
+  /// Match token::comment or token::bad_comment (the input starts with "/*").
+  template<typename Input>
+  static bool match_comment(Input& in)
+  {
+    std::size_t amount = scan::block;
+    std::size_t scanned = 2;
+    for (;;)
+    {
+      const std::size_t available = in.size(amount);
+      const char* begin = in.current();
+      const char* close = scan::find_comment_close(begin + scanned, begin + available);
+      if (close)
+      {
+        in.bump(static_cast<std::size_t>(close + 2 - begin));
+        return true;
+      }
+      if (available < amount)
+      {
+        // Unterminated: token::bad_comment consumes the rest of the input if it is valid UTF-8.
+        if (!scan::valid_utf8(begin + 2, begin + available))
+        {
+          return false;
+        }
+        in.bump(available);
+        return true;
+      }
+      // A '*' ending this block may be closed by the next one.
+      scanned = available - 1;
+      amount *= 2;
+    }
+  }
 };
 
 /// Zero or more whitespace code-points (phrased as an optional token).
@@ -311,16 +385,59 @@ struct number :
 /// Character-specifiers may be hex numbers that specify a unicode code-point
 /// or another non-newline character that might otherwise be matched by the
 /// tokenizer/parser. The latter is used, for example, as a way to include
-/// string-terminators inside strings.
+/// string-terminators inside strings. A single whitespace character
+/// (or CR LF) after a hex number ends the escape and is part of it, so
+/// that a hex digit may follow: `\31 23` is the text "123".
 struct escape :
   rule::seq<
     rule::string<'\\'>,
     rule::sor<
-      token::hex_number,
+      rule::seq<
+        token::hex_number,
+        rule::opt<
+          rule::sor<
+            token::newline,
+            rule::one<' ', '\t'>
+          >
+        >
+      >,
       rule::utf8::not_one<'\n', '\r', '\f'>
     >
   >
 {
+  /// The length of the escape at \a begin (which points to a backslash) or 0 if there is none.
+  ///
+  /// Hand-written rules use this to match an escape in place.
+  static std::size_t length(const char* begin, const char* end)
+  {
+    // token::hex_number is rule::rep_min_max<1, 6, ...>, which fails
+    // outright when a seventh hex digit follows; the escape then falls
+    // back to consuming just the first digit.
+    std::size_t digits = 0;
+    while (digits < 7 && begin + 1 + digits != end && scan::is_hex_digit(static_cast<unsigned char>(begin[1 + digits])))
+    {
+      ++digits;
+    }
+    if (digits > 0 && digits < 7)
+    {
+      const char* after = begin + 1 + digits;
+      if (after != end && *after == '\r' && after + 1 != end && after[1] == '\n')
+      {
+        return 3 + digits;
+      }
+      if (after != end && (*after == ' ' || *after == '\t' || *after == '\n' || *after == '\r' || *after == '\f'))
+      {
+        return 2 + digits;
+      }
+      return 1 + digits;
+    }
+    if (begin + 1 == end || begin[1] == '\n' || begin[1] == '\r' || begin[1] == '\f')
+    {
+      return 0;
+    }
+    const std::size_t sequence = scan::utf8_sequence(begin + 1, end);
+    return sequence ? 1 + sequence : 0;
+  }
 };
 
 struct letters_digits :
@@ -329,17 +446,79 @@ struct letters_digits :
 };
 
 /// The ending characters of an identifier.
-struct ident_suffix :
-  rule::star<
-    rule::sor<
-      token::escape,
-      token::letters_digits,
-      rule::string<'-'>,
-      rule::string<'_'>,
-      token::non_ascii
-    >
-  >
-{
+///
+/// This accepts exactly what
+/// `rule::star<rule::sor<token::escape, token::letters_digits, rule::string<'-'>, rule::string<'_'>, token::non_ascii>>`
+/// accepts, but consumes runs of `[A-Za-z0-9_-]` with a vectorized
+/// scan (see css::scan), only decoding UTF-8 or escapes when it
+/// reaches a backslash or a non-ASCII byte.
+struct ident_suffix
+{
+  using analyze_t = rule::analysis::generic<rule::analysis::rule_type::OPT>;
+
+  static constexpr first_set first()
+  {
+    return first_set::unknown();
+  }
+
+  template<typename Input>
+  static bool match(Input& in)
+  {
+    for (;;)
+    {
+      const std::size_t available = in.size(scan::block);
+      if (available == 0)
+      {
+        break;
+      }
+      const char* begin = in.current();
+      const char* stop = ident_suffix::skip(begin, begin + available, available < scan::block);
+      if (stop == begin)
+      {
+        break;
+      }
+      in.bump(static_cast<std::size_t>(stop - begin));
+    }
+    return true;
+  }
+
+  /// Return the end of the identifier characters starting at \a begin.
+  ///
+  /// Unless \a complete (i.e., \a end is the end of the input), escapes
+  /// and multi-byte characters are only decoded when they cannot be cut
+  /// off by \a end, so the result may stop short of a longer match.
+  static const char* skip(const char* begin, const char* end, bool complete)
+  {
+    // The longest escape is a backslash, six hex digits and CR LF.
+    constexpr std::ptrdiff_t margin = 9;
+    for (;;)
+    {
+      begin = scan::skip_ident_bytes(begin, end);
+      if (begin == end || (!complete && end - begin < margin))
+      {
+        return begin;
+      }
+      std::size_t length = 0;
+      if (*begin == '\\')
+      {
+        length = token::escape::length(begin, end);
+      }
+      else if (static_cast<unsigned char>(*begin) >= 0x80)
+      {
+        char32_t codepoint = 0;
+        length = scan::decode_utf8(begin, end, codepoint);
+        if (length == 0 || codepoint < 0xa0)
+        {
+          length = 0;
+        }
+      }
+      if (length == 0)
+      {
+        return begin;
+      }
+      begin += length;
+    }
+  }
 };
 
 /// A CSS identifier.
@@ -364,6 +543,172 @@ struct ident :
 {
 };
 
+/// Match a whole identifier that spells one of the \a Accepted
+/// keywords of the \a Enum family (see token::keyword_names),
+/// ignoring ASCII case.
+///
+/// The identifier is scanned once and looked up in the family's
+/// perfect hash (token::keyword_table). Unlike a `rule::istring`, a
+/// keyword never matches a prefix of a longer identifier (e.g.,
+/// `@mediafoo` is not `@media` and `12pxa` is a dimension with unit
+/// `pxa`). Actions can recover the keyword with value().
+template<typename Enum, Enum... Accepted>
+struct keyword
+{
+  using analyze_t = rule::analysis::generic<rule::analysis::rule_type::ANY>;
+  using table = keyword_table<Enum>;
+
+  static constexpr first_set first()
+  {
+    byte_set bytes;
+    const Enum accepted[] = { Accepted... };
+    for (Enum word : accepted)
+    {
+      const auto cc = static_cast<unsigned char>(table::names[static_cast<std::size_t>(word)][0]);
+      bytes.insert(cc).insert(token::other_case(cc));
+    }
+    return first_set::of_bytes(bytes);
+  }
+
+  template<typename Input>
+  static bool match(Input& in)
+  {
+    std::size_t amount = scan::block;
+    for (;;)
+    {
+      const std::size_t available = in.size(amount);
+      const char* begin = in.current();
+      const bool complete = available < amount;
+      const std::size_t length = keyword::ident_length(begin, begin + available, complete);
+      if (length > table::longest)
+      {
+        return false;
+      }
+      if (!complete && length + scan::block > available)
+      {
+        // The identifier may continue past what has been read so far.
+        amount *= 2;
+        continue;
+      }
+      if (length == 0)
+      {
+        return false;
+      }
+      const auto word = table::lookup(std::string_view(begin, length));
+      if (!word || !((*word == Accepted) || ...))
+      {
+        return false;
+      }
+      in.bump(length);
+      return true;
+    }
+  }
+
+  /// The keyword spelled by matched \a text.
+  static Enum value(std::string_view text)
+  {
+    return *table::lookup(text);
+  }
+
+  /// The length of the token::ident at \a begin (0 if there is none).
+  static std::size_t ident_length(const char* begin, const char* end, bool complete)
+  {
+    const char* cc = begin;
+    if (cc != end && *cc == '-')
+    {
+      ++cc;
+      if (cc != end && *cc == '-')
+      {
+        return static_cast<std::size_t>(ident_suffix::skip(cc + 1, end, complete) - begin);
+      }
+    }
+    if (cc == end)
+    {
+      return 0;
+    }
+    const auto lead = static_cast<unsigned char>(*cc);
+    std::size_t length = 0;
+    if (lead == '\\')
+    {
+      length = token::escape::length(cc, end);
+    }
+    else if (lead >= 0x80)
+    {
+      char32_t codepoint = 0;
+      length = scan::decode_utf8(cc, end, codepoint);
+      length = length != 0 && codepoint >= 0xa0 ? length : 0;
+    }
+    else if (((lead | 0x20) >= 'a' && (lead | 0x20) <= 'z') || lead == '_')
+    {
+      length = 1;
+    }
+    if (length == 0)
+    {
+      return 0;
+    }
+    return static_cast<std::size_t>(ident_suffix::skip(cc + length, end, complete) - begin);
+  }
+};
+
+/// At-rule names.
+enum class at_rule : std::uint8_t
+{
+  charset,
+  import,
+  media,
+  page
+};
+
+template<>
+struct keyword_names<at_rule>
+{
+  static constexpr std::string_view names[] = { "charset", "import", "media", "page" };
+};
+
+/// Units of numeric tokens.
+enum class dimension_unit : std::uint8_t
+{
+  px,
+  cm,
+  mm,
+  in,
+  pt,
+  pc,
+  em,
+  ex,
+  deg,
+  rad,
+  grad,
+  ms,
+  s,
+  hz,
+  khz
+};
+
+template<>
+struct keyword_names<dimension_unit>
+{
+  static constexpr std::string_view names[] = {
+    "px", "cm", "mm", "in", "pt", "pc", "em", "ex",
+    "deg", "rad", "grad", "ms", "s", "hz", "khz"
+  };
+};
+
+/// Words that combine and modify media queries.
+enum class media_word : std::uint8_t
+{
+  not_,
+  and_,
+  or_,
+  only
+};
+
+template<>
+struct keyword_names<media_word>
+{
+  static constexpr std::string_view names[] = { "not", "and", "or", "only" };
+};
+
 /// An ID selector (or an unrestricted selector when using the Selectors syntax)
 struct hash :
   rule::seq<
@@ -387,13 +732,14 @@ struct hexcolor :
 };
 
 struct length_units :
-  rule::sor<
-    rule::istring<'p', 'x'>,
-    rule::istring<'c', 'm'>,
-    rule::istring<'m', 'm'>,
-    rule::istring<'i', 'n'>,
-    rule::istring<'p', 't'>,
-    rule::istring<'p', 'c'>
+  token::keyword<
+    dimension_unit,
+    dimension_unit::px,
+    dimension_unit::cm,
+    dimension_unit::mm,
+    dimension_unit::in,
+    dimension_unit::pt,
+    dimension_unit::pc
   >
 {
 };
@@ -409,7 +755,7 @@ struct length :
 struct ems :
   rule::seq<
     token::number,
-    rule::istring<'e', 'm'>
+    token::keyword<dimension_unit, dimension_unit::em>
   >
 {
 };
@@ -417,16 +763,17 @@ struct ems :
 struct exs :
   rule::seq<
     token::number,
-    rule::istring<'e', 'x'>
+    token::keyword<dimension_unit, dimension_unit::ex>
   >
 {
 };
 
 struct angle_units :
-  rule::sor<
-    rule::istring<'d', 'e', 'g'>,
-    rule::istring<'r', 'a', 'd'>,
-    rule::istring<'g', 'r', 'a', 'd'>
+  token::keyword<
+    dimension_unit,
+    dimension_unit::deg,
+    dimension_unit::rad,
+    dimension_unit::grad
   >
 {
 };
@@ -440,9 +787,10 @@ struct angle :
 };
 
 struct time_units :
-  rule::sor<
-    rule::istring<'m', 's'>,
-    rule::istring<'s'>
+  token::keyword<
+    dimension_unit,
+    dimension_unit::ms,
+    dimension_unit::s
   >
 {
 };
@@ -456,9 +804,10 @@ struct time :
 };
 
 struct frequency_units :
-  rule::sor<
-    rule::istring<'h', 'z'>,
-    rule::istring<'k', 'h', 'z'>
+  token::keyword<
+    dimension_unit,
+    dimension_unit::hz,
+    dimension_unit::khz
   >
 {
 };
@@ -488,6 +837,65 @@ struct dimension :
 {
 };
 
+/// The kinds of numeric token, in the order token::unit_suffix tries them.
+enum class numeric_kind : unsigned char
+{
+  percentage,
+  length,
+  ems,
+  exs,
+  angle,
+  time,
+  frequency,
+  dimension,
+  number
+};
+
+/// A unit suffix rule tagged with the kind of numeric token it produces.
+///
+/// Actions may specialize on `token::unit<Kind, Suffix>` (or on all
+/// units at once with a partial specialization) to learn which kind
+/// of numeric token matched; the input is the suffix alone.
+template<numeric_kind Kind, typename Suffix>
+struct unit : Suffix
+{
+  static constexpr numeric_kind kind = Kind;
+};
+
+/// The unit following a number.
+///
+/// Alternatives are tried in the same order composite::term used to try
+/// token::percentage, token::length, ..., token::dimension and
+/// token::number, so the same unit wins; an empty suffix is a plain number.
+struct unit_suffix :
+  token::dispatch_sor<
+    token::unit<numeric_kind::percentage, rule::string<'%'>>,
+    token::unit<numeric_kind::length, token::length_units>,
+    token::unit<numeric_kind::ems, token::keyword<dimension_unit, dimension_unit::em>>,
+    token::unit<numeric_kind::exs, token::keyword<dimension_unit, dimension_unit::ex>>,
+    token::unit<numeric_kind::angle, token::angle_units>,
+    token::unit<numeric_kind::time, token::time_units>,
+    token::unit<numeric_kind::frequency, token::frequency_units>,
+    token::unit<numeric_kind::dimension, token::ident>,
+    token::unit<numeric_kind::number, rule::success>
+  >
+{
+};
+
+/// Any number, with or without units.
+///
+/// This accepts what `rule::sor<token::percentage, token::length, ...,
+/// token::dimension, token::number>` does, but parses the number once
+/// and then dispatches on its suffix instead of re-parsing the number
+/// for each kind of unit.
+struct numeric :
+  rule::seq<
+    token::number,
+    token::unit_suffix
+  >
+{
+};
+
 /// A ratio of two numbers (e.g., an aspect ratio used for media queries).
 struct ratio :
   rule::seq<
@@ -500,16 +908,76 @@ struct ratio :
 {
 };
 
+/// The contents of a string.
+///
+/// This accepts exactly what
+/// `rule::star<rule::sor<token::unescaped_string_data<Delimiter>, token::escape, token::line_continuation>>`
+/// accepts, but searches for the delimiter, backslashes, newlines and
+/// non-ASCII bytes with a vectorized scan (see css::scan) so that long
+/// strings (e.g., data URIs) are not decoded one code-point at a time.
+template<int Delimiter>
+struct string_data
+{
+  using analyze_t = rule::analysis::generic<rule::analysis::rule_type::OPT>;
+
+  static constexpr first_set first()
+  {
+    return first_set::unknown();
+  }
+
+  template<typename Input>
+  static bool match(Input& in)
+  {
+    for (;;)
+    {
+      const std::size_t available = in.size(scan::block);
+      if (available == 0)
+      {
+        break;
+      }
+      const char* begin = in.current();
+      const char* end = begin + available;
+      const char* stop = scan::find_stop<static_cast<char>(Delimiter), '\\', '\n', '\r', '\f'>(begin, end);
+      if (stop != begin)
+      {
+        in.bump(static_cast<std::size_t>(stop - begin));
+        continue;
+      }
+      std::size_t length = 0;
+      if (*begin == '\\')
+      {
+        length = token::escape::length(begin, end);
+        if (length == 0 && available >= 2)
+        {
+          // token::line_continuation
+          if (begin[1] == '\r' && available >= 3 && begin[2] == '\n')
+          {
+            length = 3;
+          }
+          else if (begin[1] == '\n' || begin[1] == '\r' || begin[1] == '\f')
+          {
+            length = 2;
+          }
+        }
+      }
+      else if (static_cast<unsigned char>(*begin) >= 0x80)
+      {
+        length = scan::utf8_sequence(begin, end);
+      }
+      if (length == 0)
+      {
+        break;
+      }
+      in.bump(length);
+    }
+    return true;
+  }
+};
+
 struct double_quoted_string :
   rule::seq<
     rule::string<'"'>,
-    rule::star<
-      rule::sor<
-        token::unescaped_string_data<'"'>,
-        token::escape,
-        token::line_continuation
-      >
-    >,
+    token::string_data<'"'>,
     rule::string<'"'>
   >
 {
@@ -518,39 +986,79 @@ struct double_quoted_string :
 struct single_quoted_string :
   rule::seq<
     rule::string<'\''>,
-    rule::star<
-      rule::sor<
-        token::unescaped_string_data<'\''>,
-        token::escape,
-        token::line_continuation
-      >
-    >,
+    token::string_data<'\''>,
     rule::string<'\''>
   >
 {
 };
 
 struct string :
-  rule::sor<
+  token::dispatch_sor<
     token::double_quoted_string,
     token::single_quoted_string
   >
 {
 };
 
+/// The contents of an unquoted url.
+///
+/// This accepts exactly what
+/// `rule::star<rule::sor<token::escape, rule::utf8::not_one<'"', '\'', '\\', ' '>>>`
+/// accepts, using the same vectorized scan as token::string_data.
+///
+/// FIXME: This should also omit whitespace and non-printable characters.
+struct url_data
+{
+  using analyze_t = rule::analysis::generic<rule::analysis::rule_type::OPT>;
+
+  static constexpr first_set first()
+  {
+    return first_set::unknown();
+  }
+
+  template<typename Input>
+  static bool match(Input& in)
+  {
+    for (;;)
+    {
+      const std::size_t available = in.size(scan::block);
+      if (available == 0)
+      {
+        break;
+      }
+      const char* begin = in.current();
+      const char* end = begin + available;
+      const char* stop = scan::find_stop<'"', '\'', '\\', ' '>(begin, end);
+      if (stop != begin)
+      {
+        in.bump(static_cast<std::size_t>(stop - begin));
+        continue;
+      }
+      std::size_t length = 0;
+      if (*begin == '\\')
+      {
+        length = token::escape::length(begin, end);
+      }
+      else if (static_cast<unsigned char>(*begin) >= 0x80)
+      {
+        length = scan::utf8_sequence(begin, end);
+      }
+      if (length == 0)
+      {
+        break;
+      }
+      in.bump(length);
+    }
+    return true;
+  }
+};
+
 struct url :
   rule::seq<
     rule::istring<'u', 'r', 'l'>,
     token::paren_open,
     token::optional_whitespace,
-    rule::opt<
-      rule::star<
-        rule::sor<
-          token::escape,
-          rule::utf8::not_one<'"', '\'', '\\', ' '> // FIXME: This should also omit whitespace and non-printable characters.
-        >
-      >
-    >,
+    token::url_data,
     token::optional_whitespace,
     token::paren_close
   >
@@ -558,17 +1066,17 @@ struct url :
 };
 
 struct import_keyword :
-  rule::istring<'@', 'i', 'm', 'p', 'o', 'r', 't'>
+  rule::seq<rule::string<'@'>, token::keyword<at_rule, at_rule::import>>
 {
 };
 
 struct page_keyword :
-  rule::istring<'@', 'p', 'a', 'g', 'e'>
+  rule::seq<rule::string<'@'>, token::keyword<at_rule, at_rule::page>>
 {
 };
 
 struct media_keyword :
-  rule::istring<'@', 'm', 'e', 'd', 'i', 'a'>
+  rule::seq<rule::string<'@'>, token::keyword<at_rule, at_rule::media>>
 {
 };
 
@@ -579,7 +1087,9 @@ struct encoding_charset :
 
 struct encoding :
   rule::seq<
-    rule::istring<'@', 'c', 'h', 'a', 'r', 's', 'e', 't', ' '>,
+    rule::string<'@'>,
+    token::keyword<at_rule, at_rule::charset>,
+    rule::string<' '>,
     token::encoding_charset,
     token::semicolon
   >
@@ -595,25 +1105,25 @@ struct unexpected_input :
 
 /// Media queries use "not" to invert media lists.
 struct not_keyword :
-  rule::istring<'n', 'o', 't'>
+  token::keyword<media_word, media_word::not_>
 {
 };
 
 /// Media queries use "and" to combine media queries.
 struct and_keyword :
-  rule::istring<'a', 'n', 'd'>
+  token::keyword<media_word, media_word::and_>
 {
 };
 
 /// Media queries use "or" to choose between media queries.
 struct or_keyword :
-  rule::istring<'o', 'r'>
+  token::keyword<media_word, media_word::or_>
 {
 };
 
 /// Media queries use "only" to limit a rule to a single media type.
 struct only_keyword :
-  rule::istring<'o', 'n', 'l', 'y'>
+  token::keyword<media_word, media_word::only>
 {
 };
 
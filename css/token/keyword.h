@@ -0,0 +1,170 @@
+#ifndef css_token_keyword_h
+#define css_token_keyword_h
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace css
+{
+namespace token
+{
+
+/// Specialize this for an enum to make it a keyword family.
+///
+/// Specializations provide `static constexpr std::string_view names[]`:
+/// the lower-case keyword for each enumerant, in enumerant order. An
+/// empty name (e.g., for an `unknown` enumerant) is never matched.
+template<typename Enum>
+struct keyword_names;
+
+/// A compile-time perfect hash from the (ASCII case-insensitive) names
+/// of a keyword family to its enumerants.
+///
+/// The case-folded text is hashed once (FNV-1a). The low bits of the
+/// hash pick a bucket, and a seed chosen at compile time for that
+/// bucket scatters its keywords into distinct slots of a power-of-two
+/// table (hash and displace), so even large families such as property
+/// names get a table only twice their size. Lookup then compares the
+/// text with the single candidate keyword.
+template<typename Enum>
+struct keyword_table
+{
+  static constexpr const auto& names = keyword_names<Enum>::names;
+  static constexpr std::size_t count = sizeof(names) / sizeof(names[0]);
+
+  static_assert(count < 256, "keyword families are limited to 255 keywords");
+
+  static constexpr std::size_t power_of_two(std::size_t least, std::size_t minimum)
+  {
+    std::size_t result = minimum;
+    while (result < least)
+    {
+      result *= 2;
+    }
+    return result;
+  }
+  static constexpr std::size_t slots = power_of_two(2 * count, 8);
+  static constexpr std::size_t buckets = power_of_two(count / 2, 1);
+
+  static constexpr std::size_t make_longest()
+  {
+    std::size_t longest = 0;
+    for (const auto& name : names)
+    {
+      longest = name.size() > longest ? name.size() : longest;
+    }
+    return longest;
+  }
+  static constexpr std::size_t longest = make_longest();
+
+  static constexpr unsigned char fold(char cc)
+  {
+    auto byte = static_cast<unsigned char>(cc);
+    return (byte >= 'A' && byte <= 'Z') ? static_cast<unsigned char>(byte | 0x20) : byte;
+  }
+
+  static constexpr std::uint32_t hash(std::string_view text)
+  {
+    std::uint32_t result = 2166136261u;
+    for (char cc : text)
+    {
+      result = (result ^ fold(cc)) * 16777619u;
+    }
+    return result;
+  }
+
+  static constexpr std::size_t slot(std::uint32_t hashed, std::uint16_t seed)
+  {
+    std::uint32_t mixed = (hashed ^ (seed * 0x9e3779b1u)) * 0x85ebca6bu;
+    return (mixed ^ (mixed >> 15)) & (slots - 1);
+  }
+
+  struct table_type
+  {
+    std::uint16_t seed[buckets] = {}; //!< The seed of each bucket.
+    std::uint8_t entry[slots] = {};   //!< One more than the enumerant in each slot (0 for none).
+  };
+
+  /// Place the keywords of larger buckets first, while the table is emptiest.
+  static constexpr table_type make_table()
+  {
+    table_type table;
+    std::size_t size[buckets] = {};
+    for (const auto& name : names)
+    {
+      size[hash(name) & (buckets - 1)] += name.empty() ? 0 : 1;
+    }
+    for (std::size_t members = count; members > 0; --members)
+    {
+      for (std::size_t bb = 0; bb < buckets; ++bb)
+      {
+        if (size[bb] != members)
+        {
+          continue;
+        }
+        for (std::uint16_t seed = 0;; ++seed)
+        {
+          std::uint8_t trial[slots] = {};
+          bool collision = false;
+          for (std::size_t ii = 0; ii < count && !collision; ++ii)
+          {
+            const std::uint32_t hashed = hash(names[ii]);
+            if (names[ii].empty() || (hashed & (buckets - 1)) != bb)
+            {
+              continue;
+            }
+            const std::size_t ss = slot(hashed, seed);
+            collision = table.entry[ss] != 0 || trial[ss] != 0;
+            trial[ss] = static_cast<std::uint8_t>(ii + 1);
+          }
+          if (!collision)
+          {
+            table.seed[bb] = seed;
+            for (std::size_t ss = 0; ss < slots; ++ss)
+            {
+              table.entry[ss] = trial[ss] != 0 ? trial[ss] : table.entry[ss];
+            }
+            break;
+          }
+        }
+      }
+    }
+    return table;
+  }
+  static constexpr table_type table = make_table();
+
+  /// Return the keyword spelled by \a text (ignoring ASCII case), if any.
+  static std::optional<Enum> lookup(std::string_view text)
+  {
+    if (text.empty() || text.size() > longest)
+    {
+      return std::nullopt;
+    }
+    const std::uint32_t hashed = hash(text);
+    const std::uint8_t entry = table.entry[slot(hashed, table.seed[hashed & (buckets - 1)])];
+    if (entry == 0)
+    {
+      return std::nullopt;
+    }
+    const std::string_view name = names[entry - 1];
+    if (name.size() != text.size())
+    {
+      return std::nullopt;
+    }
+    for (std::size_t ii = 0; ii < text.size(); ++ii)
+    {
+      if (fold(text[ii]) != static_cast<unsigned char>(name[ii]))
+      {
+        return std::nullopt;
+      }
+    }
+    return static_cast<Enum>(entry - 1);
+  }
+};
+
+} // token namespace
+} // css namespace
+
+#endif // css_token_keyword_h
@@ -0,0 +1,347 @@
+#ifndef css_token_scan_h
+#define css_token_scan_h
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#endif
+
+namespace css
+{
+
+/// Byte-scanning primitives used by hand-written token rules.
+///
+/// Each scanner has a vectorized implementation (AVX2 when the
+/// compiler targets it, otherwise SSE2 on x86-64) and a scalar
+/// fallback used for the tail of the input and on other targets.
+namespace scan
+{
+
+/// The number of bytes token rules ask a (possibly buffered) input for at a time.
+constexpr std::size_t block = 64;
+
+/// Returns true for the ASCII code-points with the Unicode White_Space property.
+inline bool is_ascii_whitespace(unsigned char cc)
+{
+  return cc == ' ' || (cc >= '\t' && cc <= '\r');
+}
+
+/// Returns true for [0-9a-fA-F].
+inline bool is_hex_digit(unsigned char cc)
+{
+  return (cc >= '0' && cc <= '9') || ((cc | 0x20) >= 'a' && (cc | 0x20) <= 'f');
+}
+
+inline unsigned first_set_bit(std::uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+  unsigned bit = 0;
+  while (!(mask & 1u))
+  {
+    mask >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+/// Return the first byte in [\a begin, \a end) that is not ASCII whitespace.
+inline const char* skip_ascii_whitespace(const char* begin, const char* end)
+{
+#if defined(__AVX2__)
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i below = _mm256_set1_epi8('\t' - 1);
+  const __m256i above = _mm256_set1_epi8('\r' + 1);
+  for (; end - begin >= 32; begin += 32)
+  {
+    __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i white = _mm256_or_si256(
+      _mm256_cmpeq_epi8(data, space),
+      _mm256_and_si256(_mm256_cmpgt_epi8(data, below), _mm256_cmpgt_epi8(above, data)));
+    auto mask = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(white));
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i below = _mm_set1_epi8('\t' - 1);
+  const __m128i above = _mm_set1_epi8('\r' + 1);
+  for (; end - begin >= 16; begin += 16)
+  {
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    // Signed comparisons treat bytes >= 0x80 as negative, so they never match.
+    __m128i white = _mm_or_si128(
+      _mm_cmpeq_epi8(data, space),
+      _mm_and_si128(_mm_cmpgt_epi8(data, below), _mm_cmplt_epi8(data, above)));
+    auto mask = ~static_cast<std::uint32_t>(_mm_movemask_epi8(white)) & 0xffffu;
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#endif
+  while (begin != end && is_ascii_whitespace(static_cast<unsigned char>(*begin)))
+  {
+    ++begin;
+  }
+  return begin;
+}
+
+/// Return the first occurrence of \a needle in [\a begin, \a end) or \a end.
+inline const char* find_byte(const char* begin, const char* end, char needle)
+{
+#if defined(__AVX2__)
+  const __m256i target = _mm256_set1_epi8(needle);
+  for (; end - begin >= 32; begin += 32)
+  {
+    __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, target)));
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128i target = _mm_set1_epi8(needle);
+  for (; end - begin >= 16; begin += 16)
+  {
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, target)));
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#endif
+  while (begin != end && *begin != needle)
+  {
+    ++begin;
+  }
+  return begin;
+}
+
+/// Return the first byte in [\a begin, \a end) that is one of \a Stops or is not ASCII, or \a end.
+template<char... Stops>
+inline const char* find_stop(const char* begin, const char* end)
+{
+#if defined(__AVX2__)
+  for (; end - begin >= 32; begin += 32)
+  {
+    __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    // The sign bit of each byte flags non-ASCII data.
+    __m256i hit = data;
+    ((hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(data, _mm256_set1_epi8(Stops)))), ...);
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hit));
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  for (; end - begin >= 16; begin += 16)
+  {
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    // The sign bit of each byte flags non-ASCII data.
+    __m128i hit = data;
+    ((hit = _mm_or_si128(hit, _mm_cmpeq_epi8(data, _mm_set1_epi8(Stops)))), ...);
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(hit));
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#endif
+  while (begin != end && static_cast<unsigned char>(*begin) < 0x80 && ((*begin != Stops) && ...))
+  {
+    ++begin;
+  }
+  return begin;
+}
+
+/// Return the `*` of the first "*/" in [\a begin, \a end) or nullptr.
+inline const char* find_comment_close(const char* begin, const char* end)
+{
+  for (;;)
+  {
+    begin = find_byte(begin, end, '*');
+    if (end - begin < 2)
+    {
+      return nullptr;
+    }
+    if (begin[1] == '/')
+    {
+      return begin;
+    }
+    ++begin;
+  }
+}
+
+/// Returns true for the ASCII bytes an identifier may contain unescaped: [A-Za-z0-9_-].
+inline bool is_ident_byte(unsigned char cc)
+{
+  static constexpr struct table_t
+  {
+    bool member[256];
+    constexpr table_t() : member()
+    {
+      for (int cc = 'a'; cc <= 'z'; ++cc)
+      {
+        member[cc] = member[cc - 'a' + 'A'] = true;
+      }
+      for (int cc = '0'; cc <= '9'; ++cc)
+      {
+        member[cc] = true;
+      }
+      member[static_cast<int>('_')] = member[static_cast<int>('-')] = true;
+    }
+  } table;
+  return table.member[cc];
+}
+
+/// Return the first byte in [\a begin, \a end) that is not an identifier byte (see is_ident_byte).
+inline const char* skip_ident_bytes(const char* begin, const char* end)
+{
+#if defined(__AVX2__)
+  const __m256i fold = _mm256_set1_epi8(0x20);
+  const __m256i below_a = _mm256_set1_epi8('a' - 1);
+  const __m256i above_z = _mm256_set1_epi8('z' + 1);
+  const __m256i below_0 = _mm256_set1_epi8('0' - 1);
+  const __m256i above_9 = _mm256_set1_epi8('9' + 1);
+  const __m256i underscore = _mm256_set1_epi8('_');
+  const __m256i dash = _mm256_set1_epi8('-');
+  for (; end - begin >= 32; begin += 32)
+  {
+    __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i lower = _mm256_or_si256(data, fold);
+    __m256i ident = _mm256_or_si256(
+      _mm256_or_si256(
+        _mm256_and_si256(_mm256_cmpgt_epi8(lower, below_a), _mm256_cmpgt_epi8(above_z, lower)),
+        _mm256_and_si256(_mm256_cmpgt_epi8(data, below_0), _mm256_cmpgt_epi8(above_9, data))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(data, underscore), _mm256_cmpeq_epi8(data, dash)));
+    auto mask = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(ident));
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128i fold = _mm_set1_epi8(0x20);
+  const __m128i below_a = _mm_set1_epi8('a' - 1);
+  const __m128i above_z = _mm_set1_epi8('z' + 1);
+  const __m128i below_0 = _mm_set1_epi8('0' - 1);
+  const __m128i above_9 = _mm_set1_epi8('9' + 1);
+  const __m128i underscore = _mm_set1_epi8('_');
+  const __m128i dash = _mm_set1_epi8('-');
+  for (; end - begin >= 16; begin += 16)
+  {
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    // Setting bit 5 folds upper-case letters onto lower-case ones without
+    // bringing any other byte into [a-z]; bytes >= 0x80 stay negative.
+    __m128i lower = _mm_or_si128(data, fold);
+    __m128i ident = _mm_or_si128(
+      _mm_or_si128(
+        _mm_and_si128(_mm_cmpgt_epi8(lower, below_a), _mm_cmplt_epi8(lower, above_z)),
+        _mm_and_si128(_mm_cmpgt_epi8(data, below_0), _mm_cmplt_epi8(data, above_9))),
+      _mm_or_si128(_mm_cmpeq_epi8(data, underscore), _mm_cmpeq_epi8(data, dash)));
+    auto mask = ~static_cast<std::uint32_t>(_mm_movemask_epi8(ident)) & 0xffffu;
+    if (mask)
+    {
+      return begin + first_set_bit(mask);
+    }
+  }
+#endif
+  while (begin != end && is_ident_byte(static_cast<unsigned char>(*begin)))
+  {
+    ++begin;
+  }
+  return begin;
+}
+
+/// Decode the UTF-8 sequence at \a begin into \a codepoint.
+///
+/// Returns the length of the sequence or 0 if it is invalid.
+/// Overlong forms, surrogates and code-points past U+10FFFF are
+/// rejected, as they are by PEGTL's UTF-8 rules.
+inline std::size_t decode_utf8(const char* begin, const char* end, char32_t& codepoint)
+{
+  const auto lead = static_cast<unsigned char>(*begin);
+  std::size_t length;
+  if (lead < 0x80)
+  {
+    codepoint = lead;
+    return 1;
+  }
+  else if ((lead & 0xe0) == 0xc0)
+  {
+    length = 2;
+    codepoint = lead & 0x1f;
+  }
+  else if ((lead & 0xf0) == 0xe0)
+  {
+    length = 3;
+    codepoint = lead & 0x0f;
+  }
+  else if ((lead & 0xf8) == 0xf0)
+  {
+    length = 4;
+    codepoint = lead & 0x07;
+  }
+  else
+  {
+    return 0;
+  }
+  if (static_cast<std::size_t>(end - begin) < length)
+  {
+    return 0;
+  }
+  for (std::size_t ii = 1; ii < length; ++ii)
+  {
+    const auto next = static_cast<unsigned char>(begin[ii]);
+    if ((next & 0xc0) != 0x80)
+    {
+      return 0;
+    }
+    codepoint = (codepoint << 6) | (next & 0x3f);
+  }
+  static const char32_t minimum[] = { 0, 0, 0x80, 0x800, 0x10000 };
+  if (codepoint < minimum[length] || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff))
+  {
+    return 0;
+  }
+  return length;
+}
+
+/// Returns the length of the valid UTF-8 sequence at \a begin (0 if invalid).
+inline std::size_t utf8_sequence(const char* begin, const char* end)
+{
+  char32_t codepoint;
+  return decode_utf8(begin, end, codepoint);
+}
+
+/// Returns true when [\a begin, \a end) is entirely valid UTF-8.
+inline bool valid_utf8(const char* begin, const char* end)
+{
+  while (begin != end)
+  {
+    std::size_t length = utf8_sequence(begin, end);
+    if (length == 0)
+    {
+      return false;
+    }
+    begin += length;
+  }
+  return true;
+}
+
+} // scan namespace
+} // css namespace
+
+#endif // css_token_scan_h
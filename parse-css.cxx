@@ -6,26 +6,28 @@ using smtk::common::typeName;
 #include "css/token/grammar.h"
 #include "css/composite/grammar.h"
 #include "css/parser/actions.h"
+#include "css/parser/arena.h"
+#include "css/parser/memo.h"
+#include "css/input/mapped_file.h"
+#include "css/match/index.h"
+#include "css/match/style_cache.h"
+#include "css/stream/grammar.h"
+#include "css/parallel/parse.h"
+#include "css/parallel/pool.h"
 
+#include <algorithm>
 #include <chrono>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <typeinfo>
 
-std::string read_file(const std::string& filename)
-{
-  std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-
-  std::ifstream::pos_type filesize = ifs.tellg();
-  ifs.seekg(0, std::ios::beg);
-
-  std::vector<char> bytes(filesize);
-  ifs.read(bytes.data(), filesize);
-
-  return std::string(bytes.data(), filesize);
-}
+#if CSS_HAVE_GLOB
+#  include <glob.h>
+#endif
 
 /// A namespace for cascading style sheets (CSS)
 namespace css
@@ -37,32 +39,44 @@ struct grammar : composite::stylesheet
 };
 
 template<typename Rule> using action = parser::action<Rule>;
+#if CSS_DBG_PARSE
+/// The debugging action prints the text of every rule, which rules that
+/// span a rule::discard no longer refer to (see css/stream/grammar.h).
+template<typename Rule> using stream_action = tao::css_pegtl::nothing<Rule>;
+#else
+template<typename Rule> using stream_action = parser::action<Rule>;
+#endif // CSS_DBG_PARSE
 using stylesheet = parser::stylesheet;
+using stylesheet_view = parser::stylesheet_view;
+using stylesheet_pmr = parser::pmr::stylesheet;
 
 } // css namepace
 
-int main(int argc, char* argv[])
+/// Buffered inputs cannot re-read old lines, so only print the position.
+template<typename Input>
+void print_error_context(const tao::css_pegtl::parse_error& e, Input& source)
 {
-  using namespace tao::css_pegtl;
-
-#ifdef CSS_DBG_GRAMMAR
-  if (analyze<css::grammar>() != 0 )
-  {
-    std::cerr << "CSS grammar: cycles without progress detected!\n";
-    return 1;
-  }
-  std::cout << "CSS grammar: no cycles without progress.\n";
-#endif
+  (void)e;
+  (void)source;
+}
 
-  std::string filename = argc > 1 ? argv[1] : "example.css";
-  std::string filedata = read_file(filename);
-  auto source = tao::css_pegtl::memory_input(filedata, filename);
+/// Print the line containing a parse error and point at the offending byte.
+void print_error_context(const tao::css_pegtl::parse_error& e, tao::css_pegtl::memory_input<>& source)
+{
+  const auto p = e.positions.front();
+  std::cerr
+    << source.line_as_string(p) << "\n"
+    << std::setw( p.byte ) << '^' << "\n";
+}
 
-  const auto start = std::chrono::steady_clock::now();
-  css::stylesheet sheet;
+/// Invoke \a parser (which parses \a source into \a sheet), reporting any errors.
+template<typename Parser, typename Input, typename Sheet>
+void report_parse(Parser parser, Input& source, Sheet& sheet)
+{
+  using namespace tao::css_pegtl;
   try
   {
-    bool parsed = tao::css_pegtl::parse<css::grammar, css::action>(source, sheet);
+    bool parsed = parser();
     std::cout
       << "\n\n"
       << "Encoding \"" << sheet.encoding << "\"\n"
@@ -73,16 +87,30 @@ int main(int argc, char* argv[])
   catch (parse_error& e)
   {
     std::cout << "***\n\n\n***\n\n\n";
-    (void)e;
-    const auto p = e.positions.front();
-    std::cerr
-      << e.what() << "\n"
-      << source.line_as_string(p) << "\n"
-      << std::setw( p.byte ) << '^' << "\n";
+    std::cerr << e.what() << "\n";
+    print_error_context(e, source);
     sheet.valid = false;
   }
-  const auto end = std::chrono::steady_clock::now();
-  auto dt = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+/// Parse \a source with \a Grammar into \a sheet, reporting any errors.
+template<
+  typename Grammar,
+  template<typename...> class Control = tao::css_pegtl::normal,
+  template<typename...> class Action = css::action,
+  typename Input,
+  typename Sheet>
+void parse_sheet(Input& source, Sheet& sheet)
+{
+  report_parse(
+    [&]() { return tao::css_pegtl::parse<Grammar, Action, Control>(source, sheet); },
+    source, sheet);
+}
+
+/// Print the parsed selectors and properties along with parse statistics.
+template<typename Sheet>
+void print_summary(const Sheet& sheet, std::int64_t dt)
+{
   std::size_t numRulesets = 0;
 
   // Print summary and increment counters.
@@ -96,11 +124,10 @@ int main(int argc, char* argv[])
       numRulesets += sel.second.size();
 #if !CSS_DBG_PARSE
       std::cout << "Selector <" << sel.first << ">\n";
-      sel.second.visit(
-        [](const css::parser::property& p) {
-          std::cout << "    " << p << ";\n";
-        }
-      );
+      for (const auto& p : sel.second)
+      {
+        std::cout << "    " << p << ";\n";
+      }
 #endif // !CSS_DBG_PARSE
     }
   }
@@ -115,6 +142,597 @@ int main(int argc, char* argv[])
   }
 #endif // !CSS_DBG_PARSE
   std::cout << "\n";
+#if !CSS_DBG_PARSE
+  // Without interning, each identifier would store its own copy of its text.
+  const auto& interned = sheet.accumulate.interned;
+  const auto& atoms = sheet.atoms();
+  std::cout
+    << "Interned " << interned.references << " identifiers (" << interned.bytes << " bytes)"
+    << " as " << atoms.size() << " atoms (" << atoms.bytes() << " bytes)";
+  if (interned.bytes > atoms.bytes())
+  {
+    std::cout << ", saving " << (interned.bytes - atoms.bytes()) << " bytes of text";
+  }
+  std::cout << ".\n";
+  // Selector lists and repeated rulesets share one block instead of copying it per selector.
+  const auto blocks = sheet.block_usage();
+  std::cout
+    << blocks.rules << " selectors share " << blocks.blocks << " declaration blocks"
+    << " (" << blocks.declarations << " declarations stored for " << blocks.references << " referenced),"
+    << " saving about " << blocks.saved << " bytes.\n";
+#endif // !CSS_DBG_PARSE
+}
+
+/// Build a synthetic document of \a count elements for benchmarking selector matching.
+///
+/// Elements get common HTML tags, and classes and IDs drawn from the
+/// atoms that parsing \a atoms has interned, so that some of the
+/// stylesheet's selectors match. The tree is random but the same for
+/// every run.
+std::vector<css::match::element> synthetic_document(std::size_t count, css::parser::atom_table& atoms)
+{
+  static const char* tags[] = {
+    "html", "body", "div", "span", "p", "a", "ul", "li", "section",
+    "header", "footer", "nav", "img", "button", "input", "table", "tr", "td"
+  };
+  std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+  auto random = [&seed](std::size_t bound)
+  {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return static_cast<std::size_t>((seed >> 33) % (bound ? bound : 1));
+  };
+  auto some_atom = [&]()
+  {
+    return static_cast<css::parser::atom>(1 + random(atoms.size()));
+  };
+  // Size the document up front so that parent and sibling pointers stay valid.
+  std::vector<css::match::element> document(count);
+  std::vector<std::size_t> lastChild(count, count);
+  for (std::size_t ii = 0; ii < count; ++ii)
+  {
+    auto& node = document[ii];
+    node.tag = atoms.intern(tags[ii < 2 ? ii : 2 + random(sizeof(tags) / sizeof(tags[0]) - 2)]);
+    if (ii >= 2)
+    {
+      // Prefer recent elements as parents so the tree gets deep.
+      const std::size_t parent = ii - 1 - random(std::min<std::size_t>(ii - 1, 8));
+      node.parent = &document[parent];
+      if (lastChild[parent] != count)
+      {
+        node.previous = &document[lastChild[parent]];
+        document[lastChild[parent]].next = &node;
+      }
+      lastChild[parent] = ii;
+    }
+    else if (ii == 1)
+    {
+      node.parent = &document[0];
+    }
+    if (atoms.size() > 0)
+    {
+      for (std::size_t cc = random(4); cc > 0; --cc)
+      {
+        node.classes.push_back(some_atom());
+      }
+      if (random(10) == 0)
+      {
+        node.id = some_atom();
+      }
+    }
+  }
+  return document;
+}
+
+/// Match a synthetic document of \a count elements against the rules
+/// of \a sheet, with and without the rule index (and with the index
+/// and an ancestor filter), and report the times. Then time resolving
+/// the cascade for each element (with and without a style_cache), and
+/// for a single element that every rule matched.
+template<typename Sheet>
+void benchmark_matching(const Sheet& sheet, std::size_t count)
+{
+  auto document = synthetic_document(count, sheet.atoms());
+  css::match::stylesheet_rules<Sheet> rules(sheet);
+  std::vector<css::match::selector> every;
+  for (const auto& entry : sheet.properties)
+  {
+    every.push_back(css::match::compile(std::string_view(entry.first), sheet.atoms()));
+  }
+
+  std::vector<const typename Sheet::property_data_type*> matched;
+  std::size_t tested = 0;
+  std::size_t found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& node : document)
+  {
+    matched.clear();
+    tested += rules.match(node, matched);
+    found += matched.size();
+  }
+  const auto indexed = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+
+  // Walk the document depth first so the filter always holds the current element's ancestors.
+  std::vector<std::vector<const css::match::element*>> children(count);
+  for (const auto& node : document)
+  {
+    if (node.parent)
+    {
+      children[static_cast<std::size_t>(node.parent - document.data())].push_back(&node);
+    }
+  }
+  css::match::ancestor_filter ancestors;
+  std::vector<std::pair<const css::match::element*, std::size_t>> stack;
+  std::size_t filteredTested = 0;
+  std::size_t filteredFound = 0;
+  start = std::chrono::steady_clock::now();
+  if (count > 0)
+  {
+    stack.emplace_back(&document[0], 0);
+    matched.clear();
+    filteredTested += rules.match(document[0], matched, &ancestors);
+    filteredFound += matched.size();
+    ancestors.push(document[0]);
+  }
+  while (!stack.empty())
+  {
+    auto& top = stack.back();
+    const auto& below = children[static_cast<std::size_t>(top.first - document.data())];
+    if (top.second == below.size())
+    {
+      ancestors.pop(*top.first);
+      stack.pop_back();
+      continue;
+    }
+    const css::match::element* child = below[top.second++];
+    matched.clear();
+    filteredTested += rules.match(*child, matched, &ancestors);
+    filteredFound += matched.size();
+    ancestors.push(*child);
+    stack.emplace_back(child, 0);
+  }
+  const auto filtered = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+
+  std::size_t bruteFound = 0;
+  start = std::chrono::steady_clock::now();
+  for (const auto& node : document)
+  {
+    for (const auto& compiled : every)
+    {
+      bruteFound += compiled.matches(node) ? 1 : 0;
+    }
+  }
+  const auto brute = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+
+  css::match::cascade<typename Sheet::property_type> candidates;
+  std::size_t cascaded = 0;
+  std::size_t winners = 0;
+  start = std::chrono::steady_clock::now();
+  for (const auto& node : document)
+  {
+    candidates.clear();
+    rules.apply(node, candidates);
+    cascaded += candidates.size();
+    winners += candidates.resolve().size();
+  }
+  const auto resolved = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+
+  // Styles are cached by their parent's style, so walk the document depth first as above.
+  css::match::style_cache<Sheet> cache(rules);
+  std::vector<typename css::match::style_cache<Sheet>::style_pointer> styles;
+  start = std::chrono::steady_clock::now();
+  if (count > 0)
+  {
+    stack.emplace_back(&document[0], 0);
+    styles.push_back(cache.style(document[0], nullptr));
+  }
+  while (!stack.empty())
+  {
+    auto& top = stack.back();
+    const auto& below = children[static_cast<std::size_t>(top.first - document.data())];
+    if (top.second == below.size())
+    {
+      stack.pop_back();
+      styles.pop_back();
+      continue;
+    }
+    const css::match::element* child = below[top.second++];
+    auto style = cache.style(*child, styles.back());
+    stack.emplace_back(child, 0);
+    styles.push_back(std::move(style));
+  }
+  const auto styled = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+
+  // Every rule at once stands in for an element matched by thousands of rules.
+  const std::size_t repeats = 10;
+  start = std::chrono::steady_clock::now();
+  for (std::size_t ii = 0; ii < repeats; ++ii)
+  {
+    candidates.clear();
+    for (std::uint32_t rule = 0; rule < rules.size(); ++rule)
+    {
+      candidates.add_rule(rules.rule(rule));
+    }
+    candidates.resolve();
+  }
+  const auto everyRule = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count() / static_cast<std::int64_t>(repeats);
+
+  std::cout
+    << "Matched " << count << " elements against " << rules.index().size() << " selectors: "
+    << found << " matches after testing " << tested << " candidates in " << indexed << "µs; "
+    << "with an ancestor filter, " << filteredFound << " after testing " << filteredTested
+    << " in " << filtered << "µs; "
+    << "testing every selector found " << bruteFound << " in " << brute << "µs.\n"
+    << "Cascaded " << cascaded << " declarations into " << winners << " winners in " << resolved << "µs; "
+    << "with a style cache, " << cache.hits() << " of " << (cache.hits() + cache.misses())
+    << " styles (" << static_cast<int>(100.0 * cache.hit_rate()) << "%) were reused in " << styled << "µs; "
+    << "cascading all " << candidates.size() << " declarations of every rule took " << everyRule << "µs.\n";
+}
 
-  return sheet.valid ? 0 : 1;
+/// Parse a memory-mapped file into a \a Sheet and print a summary.
+///
+/// When \a useArena is true, the stylesheet is allocated from a
+/// css::parser::arena. Either way, the number of allocations made
+/// through the stylesheet's memory resource is reported.
+///
+/// When \a parallel is true, the file is split into chunks that are
+/// parsed by \a threads threads (0 for the hardware concurrency).
+/// When \a expand is true, shorthand properties are stored as their
+/// longhands. When \a memo is true (and \a parallel is not), media
+/// queries are parsed with css::parser::memoize and the number of
+/// re-parses it avoided is reported. When \a matchElements is not 0,
+/// selector matching is benchmarked on a synthetic document with that
+/// many elements.
+///
+/// Returns true when the file was parsed without error.
+template<typename Sheet>
+bool parse_file(css::input::mapped_file& file, bool useArena, bool parallel, unsigned threads, bool expand, bool memo,
+  std::size_t matchElements)
+{
+  css::parser::arena arena;
+  css::parser::counting_resource heap;
+  std::pmr::memory_resource* resource = useArena ? arena.resource() : &heap;
+  std::unique_ptr<Sheet> sheet;
+  const auto start = std::chrono::steady_clock::now();
+  sheet.reset(new Sheet(resource));
+  sheet->expand_shorthands = expand;
+  auto source = file.input();
+  if (parallel)
+  {
+    report_parse(
+      [&]() { return css::parallel::parse(file.data(), file.size(), file.source(), *sheet, threads); },
+      source, *sheet);
+  }
+  else if (memo)
+  {
+    parse_sheet<css::grammar, css::parser::memoize>(source, *sheet);
+  }
+  else
+  {
+    parse_sheet<css::grammar>(source, *sheet);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  print_summary(*sheet, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+  bool valid = sheet->valid;
+  if (valid && matchElements != 0)
+  {
+    benchmark_matching(*sheet, matchElements);
+  }
+  const auto freed = std::chrono::steady_clock::now();
+  sheet.reset();
+  auto teardown = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - freed).count();
+  const auto& counts = useArena ? arena.requests() : heap;
+  std::cout
+    << counts.allocations() << " allocations (" << counts.bytes() << " bytes)";
+  if (useArena)
+  {
+    std::cout
+      << " served from " << arena.blocks().allocations() << " blocks"
+      << " (" << arena.blocks().bytes() << " bytes)";
+  }
+  std::cout << "; teardown took " << teardown << "µs.\n";
+  if (memo && !parallel)
+  {
+    const auto& table = css::parser::memo_table::local();
+    std::cout
+      << "Memoization avoided " << table.hits() << " of " << table.lookups()
+      << " media rule matches (skipping " << table.skipped() << " bytes).\n";
+  }
+  return valid;
+}
+
+/// Append the stylesheets named by \a path to \a files.
+///
+/// Directories are searched recursively for `.css` files and
+/// patterns containing wildcards are expanded with glob(). Returns
+/// false (after reporting it) when a pattern matches nothing.
+bool expand_input(const std::string& path, std::vector<std::string>& files)
+{
+  std::error_code error;
+  if (std::filesystem::is_directory(path, error))
+  {
+    std::vector<std::string> found;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+    {
+      if (entry.is_regular_file(error) && entry.path().extension() == ".css")
+      {
+        found.push_back(entry.path().string());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+  }
+#if CSS_HAVE_GLOB
+  if (path.find_first_of("*?[") != std::string::npos)
+  {
+    glob_t matches;
+    bool matched = ::glob(path.c_str(), 0, nullptr, &matches) == 0;
+    if (matched)
+    {
+      for (std::size_t ii = 0; ii < matches.gl_pathc; ++ii)
+      {
+        matched &= expand_input(matches.gl_pathv[ii], files);
+      }
+    }
+    else
+    {
+      std::cerr << "No files match \"" << path << "\"\n";
+    }
+    ::globfree(&matches);
+    return matched;
+  }
+#endif
+  files.push_back(path);
+  return true;
+}
+
+/// Parse many files concurrently, printing failures and aggregate throughput.
+///
+/// Each worker of the pool reuses a single arena for every file it
+/// parses, releasing it between files.
+///
+/// Returns true when every file was parsed without error.
+bool parse_batch(const std::vector<std::string>& files, unsigned threads)
+{
+  struct outcome
+  {
+    std::size_t bytes = 0;
+    bool valid = false;
+    std::string error;
+  };
+  std::vector<outcome> outcomes(files.size());
+  const auto start = std::chrono::steady_clock::now();
+  {
+    css::parallel::pool workers(threads);
+    std::vector<std::unique_ptr<css::parser::arena>> arenas;
+    for (unsigned ii = 0; ii < workers.size(); ++ii)
+    {
+      arenas.emplace_back(new css::parser::arena(1 << 20));
+    }
+    for (std::size_t ii = 0; ii < files.size(); ++ii)
+    {
+      workers.submit(
+        [&files, &outcomes, &arenas, ii](unsigned worker)
+        {
+          auto& result = outcomes[ii];
+          try
+          {
+            css::input::mapped_file file(files[ii]);
+            result.bytes = file.size();
+            auto source = file.input();
+            css::stylesheet_view sheet(arenas[worker]->resource());
+            result.valid = tao::css_pegtl::parse<css::grammar, css::action>(source, sheet);
+            if (!result.valid)
+            {
+              result.error = "does not match the stylesheet grammar";
+            }
+          }
+          catch (std::exception& e)
+          {
+            result.error = e.what();
+          }
+          arenas[worker]->release();
+        });
+    }
+    workers.wait();
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  std::size_t bytes = 0;
+  std::size_t failures = 0;
+  for (std::size_t ii = 0; ii < files.size(); ++ii)
+  {
+    bytes += outcomes[ii].bytes;
+    if (!outcomes[ii].valid)
+    {
+      ++failures;
+      std::cerr << "FAIL " << files[ii] << ": " << outcomes[ii].error << "\n";
+    }
+  }
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout
+    << files.size() << " files (" << failures << " failed), "
+    << bytes << " bytes in " << seconds << "s: "
+    << (seconds > 0 ? files.size() / seconds : 0.0) << " files/s, "
+    << (seconds > 0 ? bytes / seconds / 1e6 : 0.0) << " MB/s.\n";
+  return failures == 0;
+}
+
+int main(int argc, char* argv[])
+{
+  using namespace tao::css_pegtl;
+
+#ifdef CSS_DBG_GRAMMAR
+  if (analyze<css::grammar>() != 0 )
+  {
+    std::cerr << "CSS grammar: cycles without progress detected!\n";
+    return 1;
+  }
+  std::cout << "CSS grammar: no cycles without progress.\n";
+#endif
+
+  std::string filename = "example.css";
+  std::vector<std::string> files; // Inputs for batch mode.
+  bool batch = false; // When true, parse every input concurrently and only report failures.
+  bool inputsFound = true; // False when a pattern or list of inputs could not be expanded.
+  std::size_t window = 0; // When non-zero, parse as a stream with this many bytes buffered.
+  bool views = false; // When true, store text as views into the mapped file.
+  bool useArena = false; // When true, allocate the stylesheet from an arena.
+  bool parallel = false; // When true, parse chunks of the file concurrently.
+  bool expand = false; // When true, expand shorthand properties into longhands.
+  bool memo = false; // When true, memoize media-query rules.
+  std::size_t matchElements = 0; // When non-zero, benchmark matching a synthetic document this large.
+  unsigned threads = 0; // The number of threads used for parallel parsing (0 for all cores).
+  for (int ii = 1; ii < argc; ++ii)
+  {
+    std::string arg = argv[ii];
+    if (arg == "--stream")
+    {
+      window = css::stream::default_window;
+    }
+    else if (arg.compare(0, 9, "--stream=") == 0)
+    {
+      window = std::stoul(arg.substr(9));
+    }
+    else if (arg == "--views")
+    {
+      views = true;
+    }
+    else if (arg == "--arena")
+    {
+      useArena = true;
+    }
+    else if (arg == "--expand")
+    {
+      expand = true;
+    }
+    else if (arg == "--memo")
+    {
+      memo = true;
+    }
+    else if (arg == "--match")
+    {
+      matchElements = 10000;
+    }
+    else if (arg.compare(0, 8, "--match=") == 0)
+    {
+      matchElements = std::stoul(arg.substr(8));
+    }
+    else if (arg == "--threads")
+    {
+      parallel = true;
+    }
+    else if (arg.compare(0, 10, "--threads=") == 0)
+    {
+      parallel = true;
+      threads = static_cast<unsigned>(std::stoul(arg.substr(10)));
+    }
+    else if (arg == "--batch")
+    {
+      batch = true;
+    }
+    else if (arg.compare(0, 7, "--list=") == 0)
+    {
+      // Read one input path per line ("-" reads the list from standard input).
+      std::ifstream listFile;
+      std::string list = arg.substr(7);
+      if (list != "-")
+      {
+        listFile.open(list.c_str());
+        if (!listFile)
+        {
+          std::cerr << "Unable to open list \"" << list << "\"\n";
+          inputsFound = false;
+        }
+      }
+      std::istream& paths(list == "-" ? std::cin : listFile);
+      for (std::string line; std::getline(paths, line); )
+      {
+        if (!line.empty())
+        {
+          inputsFound &= expand_input(line, files);
+        }
+      }
+      batch = true;
+    }
+    else
+    {
+      filename = arg;
+      inputsFound &= expand_input(arg, files);
+    }
+  }
+
+  if (!inputsFound && files.empty())
+  {
+    return 1;
+  }
+  if (batch || !inputsFound || files.size() > 1 || (files.size() == 1 && files.front() != filename))
+  {
+    // Inputs that could not be found count as failures even when every file parsed.
+    return parse_batch(files, threads) && inputsFound ? 0 : 1;
+  }
+
+  if (window != 0)
+  {
+    // Views would dangle once the stream discards its buffer, so always copy.
+    std::unique_ptr<std::ifstream> stream;
+    if (filename != "-")
+    {
+      stream.reset(new std::ifstream(filename.c_str(), std::ios::in | std::ios::binary));
+      if (!*stream)
+      {
+        std::cerr << "Unable to open \"" << filename << "\"\n";
+        return 1;
+      }
+    }
+    css::stream::input source(stream ? *stream : std::cin, window, filename);
+    const auto start = std::chrono::steady_clock::now();
+    css::stylesheet sheet;
+    sheet.expand_shorthands = expand;
+    try
+    {
+      parse_sheet<css::stream::stylesheet, tao::css_pegtl::normal, css::stream_action>(source, sheet);
+    }
+    catch (std::runtime_error& e)
+    {
+      // Thrown by the buffered input when a single ruleset does not fit in the window.
+      std::cerr << e.what() << " (streaming window is " << window << " bytes)\n";
+      sheet.valid = false;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    print_summary(sheet, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    return sheet.valid ? 0 : 1;
+  }
+
+  std::unique_ptr<css::input::mapped_file> file;
+  try
+  {
+    file.reset(new css::input::mapped_file(filename));
+  }
+  catch (std::system_error& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  bool valid;
+  if (views)
+  {
+    valid = parse_file<css::stylesheet_view>(*file, useArena, parallel, threads, expand, memo, matchElements);
+  }
+  else if (useArena)
+  {
+    valid = parse_file<css::stylesheet_pmr>(*file, useArena, parallel, threads, expand, memo, matchElements);
+  }
+  else
+  {
+    valid = parse_file<css::stylesheet>(*file, useArena, parallel, threads, expand, memo, matchElements);
+  }
+  return valid ? 0 : 1;
 }